@@ -0,0 +1,201 @@
+/*FindPath for many pairs of ranked trees at once, one pair per SIMD lane*/
+
+#include "batch.h"
+
+Batch_Workspace* new_batch_workspace(long max_leaves) {
+    Batch_Workspace* workspace = malloc(sizeof(Batch_Workspace));
+    long size = (BATCH_MAX_LEAVES - 1) * BATCH_LANES * sizeof(uint64_t);
+    workspace->max_leaves = max_leaves;
+    workspace->clusters = malloc(size);
+    workspace->children = malloc(size);
+    workspace->dest = malloc(size);
+    workspace->workspace = new_findpath_workspace(max_leaves);
+    return workspace;
+}
+
+void free_batch_workspace(Batch_Workspace* workspace) {
+    free_findpath_workspace(workspace->workspace);
+    free(workspace->clusters);
+    free(workspace->children);
+    free(workspace->dest);
+    free(workspace);
+}
+
+// cluster of node of tree, for which clusters (of lane) are already known
+static uint64_t node_cluster(uint64_t* clusters,
+                             long num_leaves,
+                             long node,
+                             long lane) {
+    if (node < num_leaves) {
+        return (uint64_t)1 << node;
+    }
+    return clusters[(node - num_leaves) * BATCH_LANES + lane];
+}
+
+// write clusters (and clusters of children[0], if children != NULL) of all
+// internal nodes of tree into lane
+static void load_lane(Tree* tree,
+                      uint64_t* clusters,
+                      uint64_t* children,
+                      long lane) {
+    long num_leaves = tree->num_leaves;
+    for (long i = num_leaves; i < 2 * num_leaves - 1; i++) {
+        Node* node = &tree->node_array[i];
+        uint64_t child0 =
+            node_cluster(clusters, num_leaves, node->children[0], lane);
+        uint64_t child1 =
+            node_cluster(clusters, num_leaves, node->children[1], lane);
+        clusters[(i - num_leaves) * BATCH_LANES + lane] = child0 | child1;
+        if (children != NULL) {
+            children[(i - num_leaves) * BATCH_LANES + lane] = child0;
+        }
+    }
+}
+
+// The kernel is also compiled for AVX-512 and AVX2, and the best version the
+// CPU supports is chosen when the library is loaded
+#if defined(__GNUC__) && defined(__x86_64__)
+#define BATCH_TARGETS \
+    __attribute__((target_clones("avx512f", "avx2", "default")))
+#else
+#define BATCH_TARGETS
+#endif
+
+// FindPath on all lanes of workspace (trees on num_leaves leaves), adding the
+// distance of every lane to distances
+BATCH_TARGETS
+static void batch_kernel(Batch_Workspace* workspace,
+                         long num_leaves,
+                         int64_t* distances) {
+    long num_internal = num_leaves - 1;
+    uint64_t* clusters = workspace->clusters;
+    uint64_t* children = workspace->children;
+    int64_t mrca[BATCH_LANES];  // rank - 1 of the mrca of every lane
+    for (long i = 0; i < num_internal; i++) {
+        uint64_t* dest = &workspace->dest[i * BATCH_LANES];
+        // the lowest node whose cluster contains dest is the mrca of the
+        // children of dest, and all nodes below i are already right
+        for (long lane = 0; lane < BATCH_LANES; lane++) {
+            mrca[lane] = num_internal - 1;
+        }
+        for (long r = i; r < num_internal - 1; r++) {
+            uint64_t* cluster = &clusters[r * BATCH_LANES];
+            int64_t missing = 0;
+#pragma omp simd reduction(+ : missing)
+            for (long lane = 0; lane < BATCH_LANES; lane++) {
+                int found = (cluster[lane] & dest[lane]) == dest[lane];
+                mrca[lane] = (found && mrca[lane] > r) ? r : mrca[lane];
+                missing += (mrca[lane] == num_internal - 1);
+            }
+            if (missing == 0) {
+                break;
+            }
+        }
+        int64_t highest = i;
+        for (long lane = 0; lane < BATCH_LANES; lane++) {
+            distances[lane] += mrca[lane] - i;
+            highest = (mrca[lane] > highest) ? mrca[lane] : highest;
+        }
+        // move every mrca down to i: lanes whose mrca is at r or above do the
+        // move on the edge or the pair of nodes (r - 1, r)
+        for (long r = highest; r > i; r--) {
+            uint64_t* lower = &clusters[(r - 1) * BATCH_LANES];
+            uint64_t* upper = &clusters[r * BATCH_LANES];
+            uint64_t* lower_child = &children[(r - 1) * BATCH_LANES];
+            uint64_t* upper_child = &children[r * BATCH_LANES];
+#pragma omp simd
+            for (long lane = 0; lane < BATCH_LANES; lane++) {
+                uint64_t l = lower[lane];
+                uint64_t u = upper[lane];
+                uint64_t lc = lower_child[lane];
+                uint64_t uc = upper_child[lane];
+                int active = mrca[lane] >= r;
+                // NNI if r - 1 is a child of r: the child of r - 1 that
+                // contains a child of dest stays, its sibling moves up
+                int edge = (l & ~u) == 0;
+                uint64_t sibling = u ^ l;
+                uint64_t stays = (lc & dest[lane]) ? lc : l ^ lc;
+                uint64_t nni_lower = stays | sibling;
+                // rank move otherwise: nodes r - 1 and r swap ranks
+                lower[lane] = !active ? l : (edge ? nni_lower : u);
+                lower_child[lane] = !active ? lc : (edge ? stays : uc);
+                upper[lane] = (!active || edge) ? u : l;
+                upper_child[lane] = !active ? uc : (edge ? nni_lower : lc);
+            }
+        }
+    }
+}
+
+// distances of the pairs pairs[0..num_lanes-1] by the batch kernel. Unused
+// lanes get the same tree as start and dest tree, so they do not need moves
+static void batch_distances(Tree** start_trees,
+                            Tree** dest_trees,
+                            long* pairs,
+                            long num_lanes,
+                            Batch_Workspace* workspace,
+                            long* distances) {
+    int64_t lane_distances[BATCH_LANES];
+    long num_leaves = start_trees[pairs[0]]->num_leaves;
+    for (long lane = 0; lane < BATCH_LANES; lane++) {
+        Tree* start_tree = dest_trees[pairs[0]];
+        Tree* dest_tree = dest_trees[pairs[0]];
+        if (lane < num_lanes) {
+            start_tree = start_trees[pairs[lane]];
+            dest_tree = dest_trees[pairs[lane]];
+        }
+        load_lane(start_tree, workspace->clusters, workspace->children, lane);
+        load_lane(dest_tree, workspace->dest, NULL, lane);
+        lane_distances[lane] = 0;
+    }
+    batch_kernel(workspace, num_leaves, lane_distances);
+    for (long lane = 0; lane < num_lanes; lane++) {
+        distances[pairs[lane]] = lane_distances[lane];
+    }
+}
+
+int rnni_distances_batch(Tree** start_trees,
+                         Tree** dest_trees,
+                         long num_pairs,
+                         Batch_Workspace* workspace,
+                         long* distances) {
+    // pairs waiting for a full batch, all on num_leaves leaves
+    long pairs[BATCH_LANES];
+    long num_lanes = 0;
+    long num_leaves = 0;
+    for (long k = 0; k < num_pairs; k++) {
+        Tree* start_tree = start_trees[k];
+        Tree* dest_tree = dest_trees[k];
+        if (start_tree->num_leaves != dest_tree->num_leaves) {
+            printf("Error. The input trees have different numbers of "
+                   "leaves.\n");
+            return EXIT_FAILURE;
+        }
+        if (start_tree->num_leaves > workspace->max_leaves) {
+            printf("Error. The input trees are too big for the workspace.\n");
+            return EXIT_FAILURE;
+        }
+        if (start_tree->num_leaves > BATCH_MAX_LEAVES ||
+            is_ranked(start_tree) == FALSE || is_ranked(dest_tree) == FALSE) {
+            distances[k] = rnni_distance_workspace(start_tree, dest_tree,
+                                                   workspace->workspace);
+            continue;
+        }
+        if (num_lanes > 0 && start_tree->num_leaves != num_leaves) {
+            batch_distances(start_trees, dest_trees, pairs, num_lanes,
+                            workspace, distances);
+            num_lanes = 0;
+        }
+        num_leaves = start_tree->num_leaves;
+        pairs[num_lanes++] = k;
+        if (num_lanes == BATCH_LANES) {
+            batch_distances(start_trees, dest_trees, pairs, num_lanes,
+                            workspace, distances);
+            num_lanes = 0;
+        }
+    }
+    if (num_lanes > 0) {
+        batch_distances(start_trees, dest_trees, pairs, num_lanes, workspace,
+                        distances);
+    }
+    return EXIT_SUCCESS;
+}
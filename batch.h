@@ -0,0 +1,44 @@
+#ifndef BATCH_H_
+#define BATCH_H_
+
+#include <stdint.h>
+
+#include "rnni.h"
+
+/* Batch kernel: FindPath for BATCH_LANES pairs of ranked trees on at most
+BATCH_MAX_LEAVES leaves at once. Internal nodes are only represented by their
+clusters (bitmasks of the leaves below them) and the cluster of one of their
+children, stored in structure-of-arrays form: the values of all lanes for the
+node of one rank are next to each other. As the mrca of every lane passes
+through all ranks between its current rank and i in iteration i, the kernel
+can go through the ranks in the same order for all lanes and only needs masks
+for lanes that are already done, so that every step is the same vector
+operation on BATCH_LANES lanes without gathers or branches.
+*/
+#define BATCH_LANES 16
+#define BATCH_MAX_LEAVES 64
+
+typedef struct Batch_Workspace {
+    long max_leaves;
+    // [(rank - 1) * BATCH_LANES + lane]: clusters of the current trees, of
+    // one child of every node of the current trees, and of the dest trees
+    uint64_t* clusters;
+    uint64_t* children;
+    uint64_t* dest;
+    // for pairs the kernel does not work for
+    Findpath_Workspace* workspace;
+} Batch_Workspace;
+
+Batch_Workspace* new_batch_workspace(long max_leaves);
+void free_batch_workspace(Batch_Workspace* workspace);
+// distances[k] = RNNI distance between start_trees[k] and dest_trees[k] for
+// all k < num_pairs. Pairs of ranked trees with the same number of leaves (at
+// most BATCH_MAX_LEAVES) are given to the batch kernel BATCH_LANES at a time,
+// all others to rnni_distance_workspace
+int rnni_distances_batch(Tree** start_trees,
+                         Tree** dest_trees,
+                         long num_pairs,
+                         Batch_Workspace* workspace,
+                         long* distances);
+
+#endif
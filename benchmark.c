@@ -0,0 +1,243 @@
+/*Benchmarks for the main RNNI/SPR functions, reporting JSON
+
+Every kernel is run on batches of trees simulated under the coalescent, for
+all combinations of numbers of leaves and batch sizes. For each combination we
+report throughput (calls per second), latency percentiles of single calls (in
+microseconds), and the peak memory of the process so far (ru_maxrss, KiB).
+
+Usage: ./benchmark [-l leaves,...] [-b batch_sizes,...] [-r repetitions]
+                   [-s seed] [-o output_file]
+*/
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "exploring_rnni.h"
+#include "simulate.h"
+#include "spr.h"
+
+// sweep used if not given on the command line
+#define DEFAULT_LEAVES "16,64,256"
+#define DEFAULT_BATCH_SIZES "16,128"
+// kernels with output of size O(n^3) are only run up to this many leaves
+#define MAX_LEAVES_CUBIC 128
+
+// trees a kernel is run on: call i uses trees[i] and trees[i + 1 (mod
+// num_trees)]
+typedef struct Bench_Data {
+    Tree_Array trees;
+} Bench_Data;
+
+typedef struct Kernel {
+    char* name;
+    void (*call)(Bench_Data* data, long i);
+    long max_leaves;  // 0 for no limit
+    int whole_batch;  // TRUE if one call uses all trees of the batch
+} Kernel;
+
+static Tree* first_tree(Bench_Data* data, long i) {
+    return &data->trees.trees[i % data->trees.num_trees];
+}
+
+static Tree* second_tree(Bench_Data* data, long i) {
+    return &data->trees.trees[(i + 1) % data->trees.num_trees];
+}
+
+static void call_rnni_distance(Bench_Data* data, long i) {
+    rnni_distance(first_tree(data, i), second_tree(data, i));
+}
+
+static void call_findpath_moves(Bench_Data* data, long i) {
+    free_path(findpath_moves(first_tree(data, i), second_tree(data, i)));
+}
+
+static void call_findpath(Bench_Data* data, long i) {
+    free_tree_array(findpath(first_tree(data, i), second_tree(data, i)));
+}
+
+static void call_rnni_neighbourhood(Bench_Data* data, long i) {
+    free_tree_array(rnni_neighbourhood(first_tree(data, i)));
+}
+
+static void call_all_spr_neighbourhood(Bench_Data* data, long i) {
+    free_tree_array(all_spr_neighbourhood(first_tree(data, i), FALSE));
+}
+
+static void call_mrca_array(Bench_Data* data, long i) {
+    free(mrca_array(first_tree(data, i), second_tree(data, i)));
+}
+
+// one sos call covers the whole batch
+static void call_sos(Bench_Data* data, long i) {
+    sos(&data->trees, first_tree(data, i));
+}
+
+static Kernel kernels[] = {
+    {"rnni_distance", call_rnni_distance, 0, FALSE},
+    {"findpath_moves", call_findpath_moves, 0, FALSE},
+    {"findpath", call_findpath, MAX_LEAVES_CUBIC, FALSE},
+    {"rnni_neighbourhood", call_rnni_neighbourhood, 0, FALSE},
+    {"all_spr_neighbourhood", call_all_spr_neighbourhood, MAX_LEAVES_CUBIC,
+     FALSE},
+    {"mrca_array", call_mrca_array, 0, FALSE},
+    {"sos", call_sos, 0, TRUE},
+};
+
+static double seconds_since(struct timespec* start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) * 1e-9;
+}
+
+static int compare_doubles(const void* a, const void* b) {
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// value below which fraction p of the sorted values lie (nearest rank)
+static double percentile(double* sorted, long n, double p) {
+    long k = (long)(p * n + 0.5);
+    if (k < 1) {
+        k = 1;
+    }
+    if (k > n) {
+        k = n;
+    }
+    return sorted[k - 1];
+}
+
+static long peak_memory_kib() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+// parse comma separated list of positive numbers into values; returns number
+// of values
+static long parse_list(char* list, long* values, long max_values) {
+    long n = 0;
+    char* end = list;
+    while (*end != '\0' && n < max_values) {
+        long value = strtol(end, &end, 10);
+        if (value > 0) {
+            values[n++] = value;
+        }
+        while (*end == ',' || *end == ' ') {
+            end++;
+        }
+        if (*end != '\0' && (*end < '0' || *end > '9')) {
+            break;
+        }
+    }
+    return n;
+}
+
+// run kernel num_calls times on data and write one JSON record to out
+static void run_kernel(Kernel* kernel,
+                       Bench_Data* data,
+                       long num_leaves,
+                       long num_calls,
+                       int first,
+                       FILE* out) {
+    double* latencies = malloc(num_calls * sizeof(double));
+    struct timespec start;
+    struct timespec call_start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (long i = 0; i < num_calls; i++) {
+        clock_gettime(CLOCK_MONOTONIC, &call_start);
+        kernel->call(data, i);
+        latencies[i] = seconds_since(&call_start) * 1e6;
+    }
+    double total = seconds_since(&start);
+    qsort(latencies, num_calls, sizeof(double), compare_doubles);
+    fprintf(out,
+            "%s    {\"kernel\": \"%s\", \"num_leaves\": %ld, "
+            "\"batch_size\": %ld, \"calls\": %ld, \"seconds\": %.6f, "
+            "\"calls_per_second\": %.3f, \"latency_us\": {\"p50\": %.3f, "
+            "\"p90\": %.3f, \"p99\": %.3f, \"max\": %.3f}, "
+            "\"max_rss_kib\": %ld}",
+            first ? "" : ",\n", kernel->name, num_leaves,
+            data->trees.num_trees, num_calls, total,
+            (total > 0) ? num_calls / total : 0.0,
+            percentile(latencies, num_calls, 0.5),
+            percentile(latencies, num_calls, 0.9),
+            percentile(latencies, num_calls, 0.99),
+            latencies[num_calls - 1], peak_memory_kib());
+    fflush(out);
+    free(latencies);
+}
+
+int main(int argc, char** argv) {
+    char* leaves_list = DEFAULT_LEAVES;
+    char* batch_list = DEFAULT_BATCH_SIZES;
+    long repetitions = 3;
+    uint64_t seed = 1;
+    FILE* out = stdout;
+    int option;
+    while ((option = getopt(argc, argv, "l:b:r:s:o:")) != -1) {
+        if (option == 'l') {
+            leaves_list = optarg;
+        } else if (option == 'b') {
+            batch_list = optarg;
+        } else if (option == 'r') {
+            repetitions = strtol(optarg, NULL, 10);
+        } else if (option == 's') {
+            seed = strtoull(optarg, NULL, 10);
+        } else if (option == 'o') {
+            out = fopen(optarg, "w");
+            if (out == NULL) {
+                printf("Error. Can't open file %s.\n", optarg);
+                return EXIT_FAILURE;
+            }
+        } else {
+            fprintf(stderr,
+                    "Usage: %s [-l leaves,...] [-b batch_sizes,...] "
+                    "[-r repetitions] [-s seed] [-o output_file]\n",
+                    argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    long leaves[64];
+    long batch_sizes[64];
+    long num_leaf_counts = parse_list(leaves_list, leaves, 64);
+    long num_batch_sizes = parse_list(batch_list, batch_sizes, 64);
+    if (repetitions < 1) {
+        repetitions = 1;
+    }
+
+    fprintf(out, "{\"seed\": %lu, \"repetitions\": %ld, \"results\": [\n",
+            (unsigned long)seed, repetitions);
+    int first = TRUE;
+    long num_kernels = sizeof(kernels) / sizeof(Kernel);
+    Bench_Data data;
+    data.trees = get_empty_tree_array(0, 3);
+    for (long l = 0; l < num_leaf_counts; l++) {
+        if (leaves[l] < 3) {
+            continue;
+        }
+        for (long b = 0; b < num_batch_sizes; b++) {
+            simulate_trees(&data.trees, batch_sizes[b], leaves[l],
+                           SIM_COALESCENT, seed);
+            for (long k = 0; k < num_kernels; k++) {
+                if (kernels[k].max_leaves > 0 &&
+                    leaves[l] > kernels[k].max_leaves) {
+                    continue;
+                }
+                // every tree of the batch is used repetitions times
+                long num_calls = kernels[k].whole_batch
+                                     ? repetitions
+                                     : repetitions * batch_sizes[b];
+                run_kernel(&kernels[k], &data, leaves[l], num_calls, first,
+                           out);
+                first = FALSE;
+            }
+        }
+    }
+    fprintf(out, "\n]}\n");
+    free_tree_array(data.trees);
+    if (out != stdout) {
+        fclose(out);
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,176 @@
+/*Search for summary trees (centroids) minimising the sum of RNNI distances*/
+
+#include "centroid.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// memory one thread needs to score moves, allocated once per search
+typedef struct Centroid_Thread {
+    Findpath_Workspace* workspace;
+    Tree* neighbour;  // copy of the current tree that moves are done on
+    Reference_Tree* reference;  // neighbour that is currently scored
+} Centroid_Thread;
+
+// sos of tree: tree is preprocessed once into the reference tree of thread,
+// which is then the dest tree of the distances from all trees of tree_array
+static long sos_thread(Tree_Array* tree_array,
+                       Tree* tree,
+                       Centroid_Thread* thread) {
+    fill_reference_tree(thread->reference, tree);
+    long sum = 0;
+    for (long i = 0; i < tree_array->num_trees; i++) {
+        sum += reference_distance_workspace(&tree_array->trees[i],
+                                            thread->reference,
+                                            thread->workspace);
+    }
+    return sum;
+}
+
+// scores[i] = sos of tree after moves[i] for all begin <= i < end. Every thread
+// does the moves on its own copy of tree in threads[thread number]
+static void score_moves(Tree_Array* tree_array,
+                        Tree* tree,
+                        Move* moves,
+                        long begin,
+                        long end,
+                        Centroid_Thread* threads,
+                        long* scores) {
+#pragma omp parallel
+    {
+        Centroid_Thread* thread = &threads[0];
+#ifdef _OPENMP
+        thread = &threads[omp_get_thread_num()];
+#endif
+        copy_tree(thread->neighbour, tree);
+#pragma omp for schedule(dynamic, 1)
+        for (long i = begin; i < end; i++) {
+            apply_move(thread->neighbour, &moves[i]);
+            scores[i] = sos_thread(tree_array, thread->neighbour, thread);
+            undo_move(thread->neighbour, &moves[i]);
+        }
+    }
+}
+
+// one step of local search from tree with sos score: returns the index of the
+// move to do (-1 if tree is a local minimum) and its score in new_score
+static long find_step(Tree_Array* tree_array,
+                      Tree* tree,
+                      long score,
+                      int strategy,
+                      Move* moves,
+                      Centroid_Thread* threads,
+                      long* scores,
+                      long* new_score) {
+    long num_moves = rnni_moves(tree, moves);
+    // first improvement: score as many moves at a time as there are threads,
+    // and take the first improving move of the first block that has one, so
+    // that the chosen move is the same for any number of threads
+    long block_size = num_moves;
+    if (strategy == CENTROID_FIRST_IMPROVEMENT) {
+#ifdef _OPENMP
+        block_size = omp_get_max_threads();
+#else
+        block_size = 1;
+#endif
+    }
+    long best_move = -1;
+    long best_score = score;
+    for (long begin = 0; begin < num_moves; begin += block_size) {
+        long end = (begin + block_size < num_moves) ? begin + block_size
+                                                    : num_moves;
+        score_moves(tree_array, tree, moves, begin, end, threads, scores);
+        for (long i = begin; i < end; i++) {
+            if (scores[i] < best_score) {
+                best_move = i;
+                best_score = scores[i];
+                if (strategy == CENTROID_FIRST_IMPROVEMENT) {
+                    break;
+                }
+            }
+        }
+        if (strategy == CENTROID_FIRST_IMPROVEMENT && best_move != -1) {
+            break;
+        }
+    }
+    *new_score = best_score;
+    return best_move;
+}
+
+Centroid_Result centroid_search(Tree_Array* tree_array,
+                                Tree* start_tree,
+                                int strategy,
+                                long num_restarts,
+                                unsigned int seed) {
+    long num_leaves = start_tree->num_leaves;
+    long max_moves = 2 * (num_leaves - 1);
+    Move* moves = malloc(max_moves * sizeof(Move));
+    long* scores = malloc(max_moves * sizeof(long));
+    long num_threads = 1;
+#ifdef _OPENMP
+    num_threads = omp_get_max_threads();
+#endif
+    Centroid_Thread* threads = malloc(num_threads * sizeof(Centroid_Thread));
+    for (long t = 0; t < num_threads; t++) {
+        threads[t].workspace = new_findpath_workspace(num_leaves);
+        threads[t].neighbour = new_tree_copy(start_tree);
+        threads[t].reference = new_reference_tree(start_tree);
+    }
+
+    Centroid_Result result;
+    result.tree = new_tree_copy(start_tree);
+    result.score = -1;
+    result.num_runs = (tree_array->num_trees > 0) ? num_restarts + 1 : 1;
+    result.run_starts = malloc((result.num_runs + 1) * sizeof(long));
+    long trace_capacity = 64;
+    result.trace = malloc(trace_capacity * sizeof(long));
+    result.trace_length = 0;
+
+    Tree* current_tree = new_tree_copy(start_tree);
+    for (long run = 0; run < result.num_runs; run++) {
+        if (run > 0) {
+            long start = rand_r(&seed) % tree_array->num_trees;
+            copy_tree(current_tree, &tree_array->trees[start]);
+        }
+        result.run_starts[run] = result.trace_length;
+        long score = sos_thread(tree_array, current_tree, &threads[0]);
+        // every step decreases score, so we end in a local minimum
+        long move = 0;
+        while (move != -1) {
+            if (result.trace_length == trace_capacity) {
+                trace_capacity *= 2;
+                result.trace =
+                    realloc(result.trace, trace_capacity * sizeof(long));
+            }
+            result.trace[result.trace_length++] = score;
+            move = find_step(tree_array, current_tree, score, strategy, moves,
+                             threads, scores, &score);
+            if (move != -1) {
+                apply_move(current_tree, &moves[move]);
+            }
+        }
+        if (result.score == -1 || score < result.score) {
+            copy_tree(result.tree, current_tree);
+            result.score = score;
+        }
+    }
+    result.run_starts[result.num_runs] = result.trace_length;
+
+    for (long t = 0; t < num_threads; t++) {
+        free_findpath_workspace(threads[t].workspace);
+        free_tree(threads[t].neighbour);
+        free_reference_tree(threads[t].reference);
+    }
+    free(threads);
+    free_tree(current_tree);
+    free(moves);
+    free(scores);
+    return result;
+}
+
+void free_centroid_result(Centroid_Result result) {
+    free_tree(result.tree);
+    free(result.trace);
+    free(result.run_starts);
+}
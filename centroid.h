@@ -0,0 +1,38 @@
+#ifndef CENTROID_H_
+#define CENTROID_H_
+
+#include "spr.h"
+
+// strategies for centroid_search
+// greedy: move to the neighbour with the lowest sos in every step
+#define CENTROID_GREEDY 0
+// first improvement: move to the first neighbour (in the order of
+// rnni_neighbourhood) with lower sos
+#define CENTROID_FIRST_IMPROVEMENT 1
+
+// Result of centroid_search. trace contains the sos of the current tree at
+// the beginning of every run and after every step; run i (run 0 starts at the
+// start tree, all others at trees of tree_array) occupies positions
+// run_starts[i], ..., run_starts[i+1] - 1 of trace
+typedef struct Centroid_Result {
+    Tree* tree;  // tree with lowest sos found in all runs
+    long score;  // sos of tree
+    long* trace;
+    long trace_length;
+    long* run_starts;  // length num_runs + 1
+    long num_runs;
+} Centroid_Result;
+
+// Local search in RNNI space for a tree minimising sos (sum of RNNI distances
+// to all trees in tree_array), starting at start_tree, followed by num_restarts
+// runs starting at trees drawn uniformly from tree_array (with rand_r(seed)).
+// Every run stops in a local minimum. sos of neighbours are computed in
+// parallel (OMP_NUM_THREADS)
+Centroid_Result centroid_search(Tree_Array* tree_array,
+                                Tree* start_tree,
+                                int strategy,
+                                long num_restarts,
+                                unsigned int seed);
+void free_centroid_result(Centroid_Result result);
+
+#endif
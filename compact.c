@@ -0,0 +1,47 @@
+/*FindPath kernels for ranked trees with 8 and 16 bit node indices*/
+
+#include "compact.h"
+
+#define COMPACT_BITS 8
+#include "compact_template.h"
+#undef COMPACT_BITS
+
+#define COMPACT_BITS 16
+#include "compact_template.h"
+#undef COMPACT_BITS
+
+int compact_width(long num_leaves) {
+    if (num_leaves <= COMPACT8_MAX_LEAVES) {
+        return 1;
+    }
+    if (num_leaves <= COMPACT16_MAX_LEAVES) {
+        return 2;
+    }
+    return 0;
+}
+
+// compact tree (3 indices per node), followed by the two ancestor lists
+long compact_memory_size(long max_leaves) {
+    return 5 * (2 * max_leaves - 1) * compact_width(max_leaves);
+}
+
+long compact_findpath(Tree* start_tree,
+                      Reference_Tree* reference,
+                      long bound,
+                      void* memory,
+                      Path* path) {
+    long num_nodes = 2 * start_tree->num_leaves - 1;
+    PHASE_START(copy_start);
+    if (compact_width(start_tree->num_leaves) == 1) {
+        Compact_Node8* nodes = memory;
+        compact_tree8(nodes, start_tree);
+        PHASE_END(copy_ns, copy_start);
+        return compact_findpath8(nodes, reference, bound,
+                                 (uint8_t*)&nodes[num_nodes], path);
+    }
+    Compact_Node16* nodes = memory;
+    compact_tree16(nodes, start_tree);
+    PHASE_END(copy_ns, copy_start);
+    return compact_findpath16(nodes, reference, bound,
+                              (uint16_t*)&nodes[num_nodes], path);
+}
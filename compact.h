@@ -0,0 +1,69 @@
+#ifndef COMPACT_H_
+#define COMPACT_H_
+
+#include <stdint.h>
+
+#include "rnni.h"
+
+/* Compact trees: ranked trees whose node indices fit into 8 or 16 bits. All
+indices of a tree on n leaves are at most 2n-2, and the largest value of the
+index type marks a missing parent/child, so 8 bits work for up to 128 leaves
+and 16 bits for up to 32768 leaves. A compact node has 3 or 6 bytes instead
+of the 32 bytes of a Node (no times -- the kernels only work on ranked trees),
+so that trees on up to 128 leaves fit into a few cache lines.
+The kernels for both widths are generated from compact_template.h.
+*/
+#define COMPACT8_MAX_LEAVES 128
+#define COMPACT16_MAX_LEAVES 32768
+
+typedef struct Compact_Node8 {
+    uint8_t parent;
+    uint8_t children[2];
+} Compact_Node8;
+
+typedef struct Compact_Node16 {
+    uint16_t parent;
+    uint16_t children[2];
+} Compact_Node16;
+
+// bytes per node index of compact trees on num_leaves leaves (1 or 2), 0 if
+// num_leaves is too big for compact trees
+int compact_width(long num_leaves);
+// bytes of memory compact_findpath needs for trees with up to max_leaves
+// leaves, 0 if max_leaves is too big for compact trees
+long compact_memory_size(long max_leaves);
+// FindPath from start_tree to the tree reference was made from on a compact
+// copy of start_tree in memory (compact_memory_size bytes), choosing the
+// kernels from the number of leaves. Moves are added to path (if path !=
+// NULL). Returns the length of the path, or bound + 1 as soon as it is known to
+// be longer than bound (LONG_MAX for no bound)
+long compact_findpath(Tree* start_tree,
+                      Reference_Tree* reference,
+                      long bound,
+                      void* memory,
+                      Path* path);
+
+// kernels for 8 and 16 bit node indices -- same as the functions for Trees
+// without compact_ prefix (compact_findpath8/16: nodes is changed into the
+// dest tree, ancestors needs space for 2 * (2 * num_leaves - 1) indices)
+void compact_tree8(Compact_Node8* nodes, Tree* tree);
+int compact_nni_move8(Compact_Node8* nodes, long r, int child_moves_up);
+int compact_rank_move8(Compact_Node8* nodes, long r);
+long compact_mrca8(Compact_Node8* nodes, long node1, long node2);
+long compact_findpath8(Compact_Node8* nodes,
+                       Reference_Tree* reference,
+                       long bound,
+                       uint8_t* ancestors,
+                       Path* path);
+
+void compact_tree16(Compact_Node16* nodes, Tree* tree);
+int compact_nni_move16(Compact_Node16* nodes, long r, int child_moves_up);
+int compact_rank_move16(Compact_Node16* nodes, long r);
+long compact_mrca16(Compact_Node16* nodes, long node1, long node2);
+long compact_findpath16(Compact_Node16* nodes,
+                        Reference_Tree* reference,
+                        long bound,
+                        uint16_t* ancestors,
+                        Path* path);
+
+#endif
@@ -0,0 +1,156 @@
+/* Kernels on compact trees, included by compact.c once for every width with
+COMPACT_BITS (8 or 16) defined. No include guard: every inclusion generates
+the functions compact_*8 or compact_*16 (see compact.h)
+*/
+
+#define COMPACT_CONCAT(name, bits) name##bits
+#define COMPACT_NAME(name, bits) COMPACT_CONCAT(name, bits)
+#define FN(name) COMPACT_NAME(compact_##name, COMPACT_BITS)
+#define NODE COMPACT_NAME(Compact_Node, COMPACT_BITS)
+#define INDEX COMPACT_NAME(COMPACT_NAME(uint, COMPACT_BITS), _t)
+
+// copy parents and children of tree into nodes (-1 becomes the largest INDEX)
+void FN(tree)(NODE* nodes, Tree* tree) {
+    long num_nodes = 2 * tree->num_leaves - 1;
+    Node* node_array = tree->node_array;
+    for (long i = 0; i < num_nodes; i++) {
+        nodes[i].parent = (INDEX)node_array[i].parent;
+        nodes[i].children[0] = (INDEX)node_array[i].children[0];
+        nodes[i].children[1] = (INDEX)node_array[i].children[1];
+    }
+}
+
+int FN(nni_move)(NODE* nodes, long r, int child_moves_up) {
+    NODE* upper_node = &nodes[r + 1];
+    NODE* lower_node = &nodes[r];
+    if (lower_node->parent != r + 1) {
+        printf("Can't do an NNI - interval [%ld, %ld] is not an edge!\n", r,
+               r + 1);
+        return EXIT_FAILURE;
+    }
+    // the child of the node of rank r+1 that is not the node of rank r
+    int i = (upper_node->children[0] == r) ? 1 : 0;
+    INDEX child_moved_up = lower_node->children[child_moves_up];
+    nodes[upper_node->children[i]].parent = r;
+    nodes[child_moved_up].parent = r + 1;
+    lower_node->children[child_moves_up] = upper_node->children[i];
+    upper_node->children[i] = child_moved_up;
+    return EXIT_SUCCESS;
+}
+
+int FN(rank_move)(NODE* nodes, long r) {
+    NODE* upper_node = &nodes[r + 1];
+    NODE* lower_node = &nodes[r];
+    if (lower_node->parent == r + 1) {
+        printf(
+            "Error. No rank move possible. The interval [%ld,%ld] is an "
+            "edge!\n",
+            r, r + 1);
+        return EXIT_FAILURE;
+    }
+    // nodes swap ranks -- the node of rank r+1 is never the root here
+    INDEX upper_parent = upper_node->parent;
+    upper_node->parent = lower_node->parent;
+    lower_node->parent = upper_parent;
+    for (int i = 0; i < 2; i++) {
+        INDEX upper_child = upper_node->children[i];
+        upper_node->children[i] = lower_node->children[i];
+        lower_node->children[i] = upper_child;
+        nodes[upper_node->children[i]].parent++;
+        nodes[lower_node->children[i]].parent--;
+    }
+    // children of parents of nodes that swap ranks, without branches (if
+    // both nodes have the same parent, its children don't change)
+    if (upper_node->parent != lower_node->parent) {
+        NODE* upper_parent_node = &nodes[upper_node->parent];
+        NODE* lower_parent_node = &nodes[lower_node->parent];
+        for (int i = 0; i < 2; i++) {
+            upper_parent_node->children[i] +=
+                (upper_parent_node->children[i] == r);
+            lower_parent_node->children[i] -=
+                (lower_parent_node->children[i] == r + 1);
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+long FN(mrca)(NODE* nodes, long node1, long node2) {
+    while (node1 != node2) {
+        COUNT(mrca_steps, 1);
+        if (node1 < node2) {
+            node1 = nodes[node1].parent;
+        } else {
+            node2 = nodes[node2].parent;
+        }
+    }
+    return node1;
+}
+
+// FindPath as in reference_distance_bounded (RNNI) and
+// findpath_visit_workspace, with ancestors tracked as in track_mrca
+long FN(findpath)(NODE* nodes,
+                  Reference_Tree* reference,
+                  long bound,
+                  INDEX* ancestors,
+                  Path* path) {
+    long num_leaves = reference->num_leaves;
+    long num_nodes = 2 * num_leaves - 1;
+    INDEX* ancestors1 = ancestors;
+    INDEX* ancestors2 = ancestors + num_nodes;
+    long path_length = 0;
+    for (long i = num_leaves; i < num_nodes; i++) {
+        Reference_Node* dest_node = &reference->nodes[i - num_leaves];
+        long node1 = dest_node->children[0];
+        long node2 = dest_node->children[1];
+        long num_ancestors1 = 0;
+        long num_ancestors2 = 0;
+        while (node1 != node2) {
+            COUNT(mrca_steps, 1);
+            if (node1 < node2) {
+                ancestors1[num_ancestors1++] = node1;
+                node1 = nodes[node1].parent;
+            } else {
+                ancestors2[num_ancestors2++] = node2;
+                node2 = nodes[node2].parent;
+            }
+        }
+        long current_mrca = node1;
+        path_length += current_mrca - i;
+        if (path_length > bound) {
+            return bound + 1;
+        }
+        COUNT(decrease_mrca, current_mrca - i);
+        while (current_mrca != i) {
+            long lower_node = current_mrca - 1;
+            int move_type = 0;
+            if (nodes[lower_node].parent != current_mrca) {
+                FN(rank_move)(nodes, lower_node);
+            } else {
+                // see decrease_tracked_mrca
+                INDEX child_staying;
+                if (num_ancestors1 > 0 &&
+                    ancestors1[num_ancestors1 - 1] == lower_node) {
+                    num_ancestors1--;
+                    child_staying = ancestors1[num_ancestors1 - 1];
+                } else {
+                    num_ancestors2--;
+                    child_staying = ancestors2[num_ancestors2 - 1];
+                }
+                move_type =
+                    (nodes[lower_node].children[0] == child_staying) ? 2 : 1;
+                FN(nni_move)(nodes, lower_node, move_type == 2);
+            }
+            if (path != NULL) {
+                path_push(path, lower_node, move_type);
+            }
+            current_mrca--;
+        }
+    }
+    return path_length;
+}
+
+#undef COMPACT_CONCAT
+#undef COMPACT_NAME
+#undef FN
+#undef NODE
+#undef INDEX
@@ -0,0 +1,66 @@
+/*Per-thread instrumentation counters (see counters.h)*/
+
+#include "counters.h"
+
+#include <string.h>
+
+#include "tree.h"
+
+#ifdef TREE_COUNTERS
+_Thread_local Counters thread_counters;
+#endif
+
+int counters_enabled() {
+#ifdef TREE_COUNTERS
+    return TRUE;
+#else
+    return FALSE;
+#endif
+}
+
+Counters get_counters() {
+    Counters counters;
+    memset(&counters, 0, sizeof(Counters));
+#ifdef TREE_COUNTERS
+    counters = thread_counters;
+#endif
+    return counters;
+}
+
+void reset_counters() {
+#ifdef TREE_COUNTERS
+    memset(&thread_counters, 0, sizeof(Counters));
+#endif
+}
+
+// add counters to total
+static void add_counters(Counters* total, Counters* counters) {
+    total->decrease_mrca += counters->decrease_mrca;
+    total->length_moves += counters->length_moves;
+    total->mrca_steps += counters->mrca_steps;
+    total->tree_copies += counters->tree_copies;
+    total->allocations += counters->allocations;
+    total->copy_ns += counters->copy_ns;
+    total->mrca_ns += counters->mrca_ns;
+    total->moves_ns += counters->moves_ns;
+}
+
+// OpenMP keeps its worker threads alive between parallel regions, so every
+// parallel region sees the counters left by previous ones. The master thread
+// is part of the team, so its counters are included
+Counters get_all_counters() {
+    Counters total;
+    memset(&total, 0, sizeof(Counters));
+#pragma omp parallel
+    {
+        Counters counters = get_counters();
+#pragma omp critical
+        add_counters(&total, &counters);
+    }
+    return total;
+}
+
+void reset_all_counters() {
+#pragma omp parallel
+    reset_counters();
+}
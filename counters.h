@@ -0,0 +1,61 @@
+#ifndef COUNTERS_H_
+#define COUNTERS_H_
+
+/* Instrumentation counters for the hot paths of distance computations.
+They are only compiled in if TREE_COUNTERS is defined (make COUNTERS=1);
+otherwise COUNT and the PHASE macros do nothing and all counters stay 0.
+Every thread has its own counters, so counting needs no synchronisation.
+*/
+typedef struct Counters {
+    long decrease_mrca;  // RNNI moves decreasing an mrca (decrease_mrca and
+                         // the moves of FindPath)
+    long length_moves;   // length moves done by move_up
+    long mrca_steps;     // parent pointer steps while searching mrcas
+    long tree_copies;    // copy_tree calls
+    long allocations;    // allocations of trees, tree arrays, paths and
+                         // workspaces (including growing them)
+    // time (nanoseconds) spent in the phases of rnni_distance/findpath_moves
+    long copy_ns;   // copying start tree
+    long mrca_ns;   // finding mrcas of clusters of dest tree
+    long moves_ns;  // doing moves
+} Counters;
+
+#ifdef TREE_COUNTERS
+
+#include <time.h>
+
+extern _Thread_local Counters thread_counters;
+
+static inline long counters_now_ns() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000L + now.tv_nsec;
+}
+
+#define COUNT(counter, n) (thread_counters.counter += (n))
+// start timing a phase: declares variable name holding the start time
+#define PHASE_START(name) long name = counters_now_ns()
+// add time since PHASE_START(name) to counter
+#define PHASE_END(counter, name) \
+    (thread_counters.counter += counters_now_ns() - (name))
+
+#else
+
+#define COUNT(counter, n) ((void)0)
+#define PHASE_START(name) ((void)0)
+#define PHASE_END(counter, name) ((void)0)
+
+#endif
+
+// TRUE if counters are compiled in
+int counters_enabled();
+// counters of the calling thread
+Counters get_counters();
+// sum of counters of the calling thread and all OpenMP threads (as used by
+// the multithreaded functions)
+Counters get_all_counters();
+// set counters of calling thread / of all threads to 0
+void reset_counters();
+void reset_all_counters();
+
+#endif
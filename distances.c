@@ -0,0 +1,491 @@
+/*Distance matrices for collections of ranked trees*/
+
+#include "distances.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// tiles every thread computes between two checkpoints of a distance file
+#define DISTANCE_FILE_BATCH 4
+
+// position of the pair (i, j) with i < j in a condensed upper-triangular
+// distance matrix on num_trees trees
+long condensed_index(long num_trees, long i, long j) {
+    return i * num_trees - (i * (i + 1)) / 2 + (j - i - 1);
+}
+
+// memory every thread needs for computing distances
+typedef struct Thread_Memory {
+    Findpath_Workspace* workspace;
+    Path path;
+    Batch_Workspace* batch;
+    // pairs (and their distances) of one row of a tile for the batch kernel
+    Tree** start_trees;
+    Tree** dest_trees;
+    long* distances;
+} Thread_Memory;
+
+static Thread_Memory new_thread_memory(long num_leaves) {
+    Thread_Memory memory;
+    memory.workspace = new_findpath_workspace(num_leaves);
+    memory.path = get_empty_path(num_leaves);
+    memory.batch = new_batch_workspace(num_leaves);
+    memory.start_trees = malloc(DISTANCE_FILE_TILE_SIZE * sizeof(Tree*));
+    memory.dest_trees = malloc(DISTANCE_FILE_TILE_SIZE * sizeof(Tree*));
+    memory.distances = malloc(DISTANCE_FILE_TILE_SIZE * sizeof(long));
+    return memory;
+}
+
+static void free_thread_memory(Thread_Memory memory) {
+    free(memory.start_trees);
+    free(memory.dest_trees);
+    free(memory.distances);
+    free_batch_workspace(memory.batch);
+    free_path(memory.path);
+    free_findpath_workspace(memory.workspace);
+}
+
+// distances[k] = RNNI distance between tree i and tree j_start + k of
+// tree_array for all j_start + k < j_end (at most DISTANCE_FILE_TILE_SIZE
+// trees), computed by the batch kernel
+static int distance_row(Tree_Array* tree_array,
+                         long i,
+                         long j_start,
+                         long j_end,
+                         Thread_Memory* memory,
+                         long* distances) {
+    for (long j = j_start; j < j_end; j++) {
+        memory->start_trees[j - j_start] = &tree_array->trees[i];
+        memory->dest_trees[j - j_start] = &tree_array->trees[j];
+    }
+    return rnni_distances_batch(memory->start_trees, memory->dest_trees,
+                                j_end - j_start, memory->batch, distances);
+}
+
+// length of the FindPath path between tree i and trees j_start, ..., j_end - 1
+// (counting every length move of a run on DCTs)
+static int findpath_length_row(Tree_Array* tree_array,
+                                long i,
+                                long j_start,
+                                long j_end,
+                                Thread_Memory* memory,
+                                long* lengths) {
+    for (long j = j_start; j < j_end; j++) {
+        if (findpath_moves_workspace(&tree_array->trees[i],
+                                     &tree_array->trees[j], memory->workspace,
+                                     &memory->path) != EXIT_SUCCESS) {
+            return EXIT_FAILURE;
+        }
+        lengths[j - j_start] = path_distance(&memory->path);
+    }
+    return EXIT_SUCCESS;
+}
+
+// Fill condensed matrix with distance(tree_i, tree_j) for all i < j, with
+// the distances of the pairs of one row of a tile computed by row (which
+// returns EXIT_FAILURE if it couldn't compute them).
+// The matrix is split into square tiles of DISTANCE_TILE_SIZE x
+// DISTANCE_TILE_SIZE pairs (triangular on the diagonal), which are handed out
+// to threads one at a time, so threads that finish early keep taking tiles
+// until none are left
+static int fill_condensed_matrix(Tree_Array* tree_array,
+                                 long* matrix,
+                                 int (*row)(Tree_Array*,
+                                            long,
+                                            long,
+                                            long,
+                                            Thread_Memory*,
+                                            long*)) {
+    long num_trees = tree_array->num_trees;
+    if (num_trees < 2) {
+        return EXIT_SUCCESS;
+    }
+    for (long i = 1; i < num_trees; i++) {
+        if (tree_array->trees[i].num_leaves !=
+            tree_array->trees[0].num_leaves) {
+            printf("Error. The input trees have different numbers of "
+                   "leaves.\n");
+            return EXIT_FAILURE;
+        }
+    }
+    long num_blocks = (num_trees + DISTANCE_TILE_SIZE - 1) / DISTANCE_TILE_SIZE;
+    long num_tiles = (num_blocks * (num_blocks + 1)) / 2;
+
+    // tile_rows[t], tile_cols[t]: block indices of tile t (tile_rows[t] <=
+    // tile_cols[t])
+    long* tile_rows = malloc(num_tiles * sizeof(long));
+    long* tile_cols = malloc(num_tiles * sizeof(long));
+    long t = 0;
+    for (long row = 0; row < num_blocks; row++) {
+        for (long col = row; col < num_blocks; col++) {
+            tile_rows[t] = row;
+            tile_cols[t] = col;
+            t++;
+        }
+    }
+
+    long num_leaves = tree_array->trees[0].num_leaves;
+    int result = EXIT_SUCCESS;
+#pragma omp parallel
+    {
+        // every thread reuses its own memory for all its distances
+        Thread_Memory memory = new_thread_memory(num_leaves);
+
+#pragma omp for schedule(dynamic, 1)
+        for (long tile = 0; tile < num_tiles; tile++) {
+            long row_start = tile_rows[tile] * DISTANCE_TILE_SIZE;
+            long row_end = row_start + DISTANCE_TILE_SIZE;
+            long col_start = tile_cols[tile] * DISTANCE_TILE_SIZE;
+            long col_end = col_start + DISTANCE_TILE_SIZE;
+            if (row_end > num_trees) {
+                row_end = num_trees;
+            }
+            if (col_end > num_trees) {
+                col_end = num_trees;
+            }
+            for (long i = row_start; i < row_end; i++) {
+                // on diagonal tiles only consider pairs above the diagonal
+                long j = (col_start > i + 1) ? col_start : i + 1;
+                // pairs of a row are next to each other in matrix
+                if (j < col_end &&
+                    row(tree_array, i, j, col_end, &memory,
+                        &matrix[condensed_index(num_trees, i, j)]) !=
+                        EXIT_SUCCESS) {
+#pragma omp atomic write
+                    result = EXIT_FAILURE;
+                }
+            }
+        }
+
+        free_thread_memory(memory);
+    }
+
+    free(tile_rows);
+    free(tile_cols);
+    return result;
+}
+
+// RNNI distances between all pairs of trees in tree_array (condensed
+// upper-triangular order)
+int rnni_distance_matrix(Tree_Array* tree_array, long* distances) {
+    return fill_condensed_matrix(tree_array, distances, distance_row);
+}
+
+// Lengths of FindPath paths between all pairs of trees in tree_array
+// (condensed upper-triangular order)
+int findpath_length_matrix(Tree_Array* tree_array, long* lengths) {
+    return fill_condensed_matrix(tree_array, lengths, findpath_length_row);
+}
+
+// fingerprint of the trees of tree_array (and their order)
+static uint64_t trees_fingerprint(Tree_Array* tree_array) {
+    long num_trees = tree_array->num_trees;
+    uint64_t fingerprint = rng_mix(num_trees);
+#pragma omp parallel for schedule(static) reduction(+ : fingerprint)
+    for (long i = 0; i < num_trees; i++) {
+        Tree* tree = &tree_array->trees[i];
+        uint64_t hash = tree_hash(tree);
+        // tree_hash only depends on parents, so add times that are not ranks
+        // (DCTs)
+        long num_leaves = tree->num_leaves;
+        for (long j = num_leaves; j < 2 * num_leaves - 1; j++) {
+            long time = tree->node_array[j].time;
+            if (time != j - num_leaves + 1) {
+                hash += rng_mix((uint64_t)j * RNG_GAMMA ^ (uint64_t)time);
+            }
+        }
+        fingerprint += rng_mix(hash ^ ((uint64_t)i * RNG_GAMMA));
+    }
+    return fingerprint;
+}
+
+// largest distance between two trees of tree_array: RNNI distances of ranked
+// trees are at most (n-1)(n-2)/2. A DCT is sum(time - rank) length moves away
+// from the ranked tree with the same ranking, so distances between DCTs are
+// at most twice the biggest such sum more
+static long max_file_distance(Tree_Array* tree_array, long num_leaves) {
+    long max_excess = 0;
+    for (long i = 0; i < tree_array->num_trees; i++) {
+        Node* nodes = tree_array->trees[i].node_array;
+        long excess = 0;
+        for (long j = num_leaves; j < 2 * num_leaves - 1; j++) {
+            excess += nodes[j].time - (j - num_leaves + 1);
+        }
+        max_excess = (excess > max_excess) ? excess : max_excess;
+    }
+    return (num_leaves - 1) * (num_leaves - 2) / 2 + 2 * max_excess;
+}
+
+// bytes rounded up to a multiple of the page size
+static long page_round(long bytes, long page_size) {
+    return (bytes + page_size - 1) / page_size * page_size;
+}
+
+// write bytes [start, end) of map to disk
+static void sync_range(char* map, long start, long end, long page_size) {
+    start = start / page_size * page_size;
+    if (end > start) {
+        msync(map + start, end - start, MS_SYNC);
+    }
+}
+
+// header of a distance file for tree_array
+static Distance_File_Header distance_file_header(Tree_Array* tree_array) {
+    long num_trees = tree_array->num_trees;
+    long num_leaves = (num_trees > 0) ? tree_array->trees[0].num_leaves : 3;
+    long page_size = sysconf(_SC_PAGESIZE);
+    long num_blocks = (num_trees + DISTANCE_FILE_TILE_SIZE - 1) /
+                      DISTANCE_FILE_TILE_SIZE;
+    Distance_File_Header header;
+    memset(&header, 0, sizeof(Distance_File_Header));
+    memcpy(header.magic, DISTANCE_FILE_MAGIC, 8);
+    header.version = DISTANCE_FILE_VERSION;
+    header.byte_order = 1;
+    header.num_trees = num_trees;
+    header.num_leaves = num_leaves;
+    header.fingerprint = trees_fingerprint(tree_array);
+    // entry_size 0: distances might not fit into 32 bits
+    long max_distance = max_file_distance(tree_array, num_leaves);
+    header.entry_size = (max_distance <= UINT16_MAX)   ? 2
+                        : (max_distance <= UINT32_MAX) ? 4
+                                                       : 0;
+    header.tile_size = DISTANCE_FILE_TILE_SIZE;
+    header.num_tiles = (num_blocks * (num_blocks + 1)) / 2;
+    header.tiles_offset = page_round(sizeof(Distance_File_Header), page_size);
+    header.entries_offset =
+        header.tiles_offset + page_round(header.num_tiles, page_size);
+    return header;
+}
+
+// distances of the pairs (i, j), i < j, of tile with blocks row, col are at
+// positions [*first, *last) of the condensed matrix (empty if *first == *last)
+static void tile_range(long num_trees,
+                       long row,
+                       long col,
+                       long* first,
+                       long* last) {
+    long row_start = row * DISTANCE_FILE_TILE_SIZE;
+    long col_start = col * DISTANCE_FILE_TILE_SIZE;
+    long row_end = row_start + DISTANCE_FILE_TILE_SIZE;
+    long col_end = col_start + DISTANCE_FILE_TILE_SIZE;
+    row_end = (row_end > num_trees) ? num_trees : row_end;
+    col_end = (col_end > num_trees) ? num_trees : col_end;
+    // the last row with pairs in this tile
+    if (row == col) {
+        row_end--;
+    }
+    *first = 0;
+    *last = 0;
+    if (row_start < row_end) {
+        long j = (col_start > row_start + 1) ? col_start : row_start + 1;
+        *first = condensed_index(num_trees, row_start, j);
+        *last = condensed_index(num_trees, row_end - 1, col_end - 1) + 1;
+    }
+}
+
+// compute distances of tile with blocks row, col and write them into entries
+static void fill_distance_tile(Tree_Array* tree_array,
+                               long row,
+                               long col,
+                               char* entries,
+                               long entry_size,
+                               Thread_Memory* memory) {
+    long num_trees = tree_array->num_trees;
+    long row_start = row * DISTANCE_FILE_TILE_SIZE;
+    long col_start = col * DISTANCE_FILE_TILE_SIZE;
+    long row_end = row_start + DISTANCE_FILE_TILE_SIZE;
+    long col_end = col_start + DISTANCE_FILE_TILE_SIZE;
+    row_end = (row_end > num_trees) ? num_trees : row_end;
+    col_end = (col_end > num_trees) ? num_trees : col_end;
+    for (long i = row_start; i < row_end; i++) {
+        long j_start = (col_start > i + 1) ? col_start : i + 1;
+        if (j_start >= col_end) {
+            continue;
+        }
+        // can't fail: all trees have the same number of leaves (checked by
+        // rnni_distance_matrix_file)
+        distance_row(tree_array, i, j_start, col_end, memory,
+                     memory->distances);
+        for (long j = j_start; j < col_end; j++) {
+            long distance = memory->distances[j - j_start];
+            long index = condensed_index(num_trees, i, j);
+            if (entry_size == 2) {
+                ((uint16_t*)entries)[index] = distance;
+            } else {
+                ((uint32_t*)entries)[index] = distance;
+            }
+        }
+    }
+}
+
+long rnni_distance_matrix_file(Tree_Array* tree_array,
+                               char* filename,
+                               long max_tiles) {
+    long num_trees = tree_array->num_trees;
+    for (long i = 1; i < num_trees; i++) {
+        if (tree_array->trees[i].num_leaves !=
+            tree_array->trees[0].num_leaves) {
+            printf("Error. The input trees have different numbers of "
+                   "leaves.\n");
+            return -1;
+        }
+    }
+    Distance_File_Header expected = distance_file_header(tree_array);
+    if (expected.entry_size == 0) {
+        printf("Error. The distances between these trees are too big for a "
+               "distance file.\n");
+        return -1;
+    }
+    long num_pairs = num_trees * (num_trees - 1) / 2;
+    long file_size = expected.entries_offset + num_pairs * expected.entry_size;
+    long page_size = sysconf(_SC_PAGESIZE);
+
+    int fd = open(filename, O_RDWR | O_CREAT, 0644);
+    if (fd == -1) {
+        printf("Error. Can't open file %s.\n", filename);
+        return -1;
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 ||
+        (file_stat.st_size != 0 && file_stat.st_size != file_size)) {
+        printf("Error. %s is not a distance file for these trees.\n",
+               filename);
+        close(fd);
+        return -1;
+    }
+    // new files are sparse and all tiles are marked as missing (0)
+    if (file_stat.st_size == 0 && ftruncate(fd, file_size) != 0) {
+        printf("Error. Can't write file %s.\n", filename);
+        close(fd);
+        return -1;
+    }
+    char* map =
+        mmap(NULL, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        printf("Error. Can't map file %s into memory.\n", filename);
+        return -1;
+    }
+    Distance_File_Header* header = (Distance_File_Header*)map;
+    char empty[8] = {0};
+    if (memcmp(header->magic, empty, 8) == 0) {
+        // new file (or the header never reached the disk)
+        memcpy(header, &expected, sizeof(Distance_File_Header));
+        sync_range(map, 0, sizeof(Distance_File_Header), page_size);
+    } else if (memcmp(header, &expected, sizeof(Distance_File_Header)) != 0) {
+        printf("Error. %s is not a distance file for these trees.\n",
+               filename);
+        munmap(map, file_size);
+        return -1;
+    }
+
+    // the tiles that are missing (index and blocks), in order
+    unsigned char* done = (unsigned char*)map + header->tiles_offset;
+    char* entries = map + header->entries_offset;
+    long num_tiles = header->num_tiles;
+    long num_blocks =
+        (num_trees + DISTANCE_FILE_TILE_SIZE - 1) / DISTANCE_FILE_TILE_SIZE;
+    long* tiles = malloc((num_tiles + 1) * sizeof(long));
+    long* tile_rows = malloc((num_tiles + 1) * sizeof(long));
+    long* tile_cols = malloc((num_tiles + 1) * sizeof(long));
+    long num_missing = 0;
+    long t = 0;
+    for (long row = 0; row < num_blocks; row++) {
+        for (long col = row; col < num_blocks; col++) {
+            if (done[t] == 0) {
+                tiles[num_missing] = t;
+                tile_rows[num_missing] = row;
+                tile_cols[num_missing] = col;
+                num_missing++;
+            }
+            t++;
+        }
+    }
+    long num_todo = (max_tiles < 0 || max_tiles > num_missing) ? num_missing
+                                                              : max_tiles;
+    long batch_size = DISTANCE_FILE_BATCH;
+#ifdef _OPENMP
+    batch_size *= omp_get_max_threads();
+#endif
+
+    long num_leaves = header->num_leaves;
+#pragma omp parallel
+    {
+        Thread_Memory memory = new_thread_memory(num_leaves);
+        for (long start = 0; start < num_todo; start += batch_size) {
+            long end =
+                (start + batch_size < num_todo) ? start + batch_size : num_todo;
+#pragma omp for schedule(dynamic, 1)
+            for (long k = start; k < end; k++) {
+                fill_distance_tile(tree_array, tile_rows[k], tile_cols[k],
+                                   entries, header->entry_size, &memory);
+            }
+            // checkpoint: distances of the batch are written to disk before
+            // the tiles are marked as done
+#pragma omp single
+            {
+                long first = num_pairs;
+                long last = 0;
+                for (long k = start; k < end; k++) {
+                    long tile_first, tile_last;
+                    tile_range(num_trees, tile_rows[k], tile_cols[k],
+                               &tile_first, &tile_last);
+                    if (tile_first < tile_last) {
+                        first = (tile_first < first) ? tile_first : first;
+                        last = (tile_last > last) ? tile_last : last;
+                    }
+                }
+                if (first < last) {
+                    sync_range(entries, first * header->entry_size,
+                               last * header->entry_size, page_size);
+                }
+                for (long k = start; k < end; k++) {
+                    done[tiles[k]] = 1;
+                }
+                // missing tiles are in order
+                sync_range((char*)done, tiles[start], tiles[end - 1] + 1,
+                           page_size);
+            }
+        }
+        free_thread_memory(memory);
+    }
+
+    free(tiles);
+    free(tile_rows);
+    free(tile_cols);
+    munmap(map, file_size);
+    return num_missing - num_todo;
+}
+
+// Distances from all trees in tree_array to one reference tree. Every thread
+// takes trees in chunks of DISTANCE_TILE_SIZE, reusing its workspace
+int rnni_distances_to(Tree_Array* tree_array,
+                      Reference_Tree* reference,
+                      long* distances) {
+    long num_trees = tree_array->num_trees;
+    for (long i = 0; i < num_trees; i++) {
+        if (tree_array->trees[i].num_leaves != reference->num_leaves) {
+            printf("Error. The input trees have different numbers of "
+                   "leaves.\n");
+            return EXIT_FAILURE;
+        }
+    }
+#pragma omp parallel
+    {
+        Findpath_Workspace* workspace =
+            new_findpath_workspace(reference->num_leaves);
+#pragma omp for schedule(dynamic, DISTANCE_TILE_SIZE)
+        for (long i = 0; i < num_trees; i++) {
+            distances[i] = reference_distance_workspace(
+                &tree_array->trees[i], reference, workspace);
+        }
+        free_findpath_workspace(workspace);
+    }
+    return EXIT_SUCCESS;
+}
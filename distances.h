@@ -0,0 +1,74 @@
+#ifndef DISTANCES_H_
+#define DISTANCES_H_
+
+#include "batch.h"
+
+// Number of trees per side of a tile of the distance matrix. Pairs are
+// scheduled tile by tile, so every thread works on 2 * DISTANCE_TILE_SIZE trees
+// at a time
+#define DISTANCE_TILE_SIZE 32
+
+// position of the pair (i, j) with i < j in a condensed upper-triangular
+// distance matrix on num_trees trees
+long condensed_index(long num_trees, long i, long j);
+
+// Fill distances (length num_trees * (num_trees - 1) / 2) with the RNNI
+// distances of all pairs of trees in tree_array, in condensed upper-triangular
+// order: (0,1), (0,2), ..., (0,n-1), (1,2), ...
+// Returns EXIT_FAILURE if the trees have different numbers of leaves.
+// Uses all available threads (OMP_NUM_THREADS)
+int rnni_distance_matrix(Tree_Array* tree_array, long* distances);
+// Same as rnni_distance_matrix, but with the lengths of the paths computed by
+// findpath_moves
+int findpath_length_matrix(Tree_Array* tree_array, long* lengths);
+
+/* File with a condensed RNNI distance matrix that is too big for memory:
+Header (Distance_File_Header), followed by one byte per tile of the matrix
+(tiles of DISTANCE_FILE_TILE_SIZE x DISTANCE_FILE_TILE_SIZE pairs in the
+order (0,0), (0,1), ..., (1,1), ... of their blocks of trees) at tiles_offset,
+which is 1 once all distances of the tile are on disk, followed by the
+condensed matrix (order as in rnni_distance_matrix) at entries_offset with
+entry_size bytes per distance: uint16_t if all distances are below 2^16,
+uint32_t otherwise. For DCTs the bound for the distances grows with the times
+of the nodes. Both offsets are multiples of the page size.
+*/
+#define DISTANCE_FILE_MAGIC "RNNIDIST"
+#define DISTANCE_FILE_VERSION 1
+#define DISTANCE_FILE_TILE_SIZE 256
+
+typedef struct Distance_File_Header {
+    char magic[8];
+    long version;
+    long byte_order;  // 1 in the byte order of the writing machine
+    long num_trees;
+    long num_leaves;
+    uint64_t fingerprint;  // of the trees (with times of DCTs)
+    long entry_size;
+    long tile_size;
+    long num_tiles;
+    long tiles_offset;
+    long entries_offset;
+} Distance_File_Header;
+
+// rnni_distance_matrix written to the memory mapped file filename, one tile
+// after the other, so that the matrix does not need to fit into memory. If
+// the file exists, its header needs to match tree_array (number of trees,
+// leaves, entry size, and a fingerprint of all tree_hash values and the times
+// of DCTs) and only the tiles that are not marked as done are computed, so an
+// interrupted computation resumes where it stopped. Tiles are marked as done
+// in batches, after their distances were written to disk (msync). At most
+// max_tiles tiles are computed (all if max_tiles < 0). Returns the number of
+// tiles that are still missing, -1 on error. Uses all available threads
+// (OMP_NUM_THREADS)
+long rnni_distance_matrix_file(Tree_Array* tree_array,
+                               char* filename,
+                               long max_tiles);
+
+// Fill distances (length num_trees) with the RNNI distances from every tree in
+// tree_array to the tree reference was made from (new_reference_tree)
+// Uses all available threads (OMP_NUM_THREADS)
+int rnni_distances_to(Tree_Array* tree_array,
+                      Reference_Tree* reference,
+                      long* distances);
+
+#endif
@@ -14,33 +14,98 @@ long random_walk_distance(Tree* tree, long k) {
     return (distance);
 }
 
+// Random walks of length k from tree, in parallel. Every thread does its walks
+// on its own copy of tree, and distances to tree are computed against tree
+// preprocessed once (Reference_Tree)
+int random_walks(Tree* tree,
+                 long num_walks,
+                 long k,
+                 uint64_t seed,
+                 long* trajectories) {
+    long num_leaves = tree->num_leaves;
+    if (num_leaves < 3 && k > 0) {
+        printf("Error. There are no RNNI moves on trees with %ld leaves.\n",
+               num_leaves);
+        return EXIT_FAILURE;
+    }
+    Reference_Tree* reference = new_reference_tree(tree);
+#pragma omp parallel
+    {
+        Findpath_Workspace* workspace = new_findpath_workspace(num_leaves);
+        Tree* current_tree = new_tree_copy(tree);
+#pragma omp for schedule(dynamic, 1)
+        for (long i = 0; i < num_walks; i++) {
+            Rng rng = rng_stream(seed, i);
+            long* trajectory = &trajectories[i * (k + 1)];
+            copy_tree(current_tree, tree);
+            trajectory[0] = 0;
+            for (long j = 1; j <= k; j++) {
+                uniform_neighbour_rng(current_tree, &rng, NULL);
+                trajectory[j] = reference_distance_workspace(
+                    current_tree, reference, workspace);
+            }
+        }
+        free_tree(current_tree);
+        free_findpath_workspace(workspace);
+    }
+    free_reference_tree(reference);
+    return EXIT_SUCCESS;
+}
+
 // perform one iteration of FindPath on every tree in tree_array, such that
 // resulting tree has mrca of node1 and node2 at position r Note that this may
 // change every tree in tree_array
 int first_iteration_fp(Tree_Array* tree_array, long node1, long node2, long r) {
-    for (long i = 0; i < tree_array->num_trees; i++) {
-        while (mrca(&tree_array->trees[i], node1, node2) > r) {
-            decrease_mrca(&tree_array->trees[i], node1, node2);
+    if (tree_array->num_trees == 0) {
+        return 0;
+    }
+    long num_leaves = tree_array->trees[0].num_leaves;
+#pragma omp parallel
+    {
+        Findpath_Workspace* workspace = new_findpath_workspace(num_leaves);
+#pragma omp for schedule(dynamic, DISTANCE_TILE_SIZE)
+        for (long i = 0; i < tree_array->num_trees; i++) {
+            decrease_mrca_to(&tree_array->trees[i], node1, node2, r,
+                             workspace);
         }
+        free_findpath_workspace(workspace);
     }
     return 0;
 }
 
-// compute sum of squared distances for all tree in tree_array to focal_tree
+// compute sum of distances for all tree in tree_array to focal_tree, with
+// focal_tree preprocessed once for all distances
 long sos(Tree_Array* tree_array, Tree* focal_tree) {
+    long* distances = malloc(tree_array->num_trees * sizeof(long));
+    Reference_Tree* reference = new_reference_tree(focal_tree);
     long sos = 0;
-    for (long i = 0; i < tree_array->num_trees; i++) {
-        sos += rnni_distance(&tree_array->trees[i], focal_tree);
+    if (rnni_distances_to(tree_array, reference, distances) != EXIT_SUCCESS) {
+        sos = -1;
     }
+    for (long i = 0; sos != -1 && i < tree_array->num_trees; i++) {
+        sos += distances[i];
+    }
+    free_reference_tree(reference);
+    free(distances);
     return sos;
 }
 
 // returns array with rank(mrca_{tree1}(C_i)) at position i where C_i is the
 // cluster induced by node of rank i in tree2
 long* mrca_array(Tree* tree1, Tree* tree2) {
-    long num_leaves = tree1->num_leaves;
-    long num_nodes = 2 * num_leaves - 1;
+    long num_nodes = 2 * tree1->num_leaves - 1;
     long* mrca_array = calloc(num_nodes, sizeof(long));
+    Mrca_Index* index1 = new_mrca_index(tree1);
+    fill_mrca_array(index1, tree2, mrca_array);
+    free_mrca_index(index1);
+    return mrca_array;
+}
+
+// mrca_array for tree1 given by its Mrca_Index index1, written into mrcas
+// (length 2 * num_leaves - 1)
+void fill_mrca_array(Mrca_Index* index1, Tree* tree2, long* mrcas) {
+    long num_leaves = tree2->num_leaves;
+    long num_nodes = 2 * num_leaves - 1;
 
     for (long i = num_leaves; i < num_nodes; i++) {
         // find nodes (child0, child1) in tree1 that are mrcas of the clusters
@@ -49,20 +114,18 @@ long* mrca_array(Tree* tree1, Tree* tree2) {
         if (tree2->node_array[i].children[0] < num_leaves) {
             child0 = tree2->node_array[i].children[0];
         } else {
-            child0 = mrca_array[tree2->node_array[i].children[0]];
+            child0 = mrcas[tree2->node_array[i].children[0]];
         }
 
         long child1;
         if (tree2->node_array[i].children[1] < num_leaves) {
             child1 = tree2->node_array[i].children[1];
         } else {
-            child1 = mrca_array[tree2->node_array[i].children[1]];
+            child1 = mrcas[tree2->node_array[i].children[1]];
         }
 
-        long current_mrca = mrca(tree1, child0, child1);
-        mrca_array[i] = current_mrca;
+        mrcas[i] = mrca_index_query(index1, child0, child1);
     }
-    return mrca_array;
 }
 
 // Compute differences of ranks of mrcas of all clusters of tree2 btw tree1 and
@@ -75,16 +138,33 @@ long mrca_differences(Tree* tree1, Tree* tree2, int include_leaf_parents) {
     if (include_leaf_parents == TRUE) {
         for (long i = 0; i < num_leaves; i++) {
             sum +=
-                abs(tree1->node_array[i].parent - tree2->node_array[i].parent);
+                labs(tree1->node_array[i].parent - tree2->node_array[i].parent);
         }
     }
     long* mrcas = mrca_array(tree1, tree2);
     for (long i = num_leaves; i < num_nodes; i++) {
         sum += mrcas[i] - i;
     }
+    free(mrcas);
     return sum;
 }
 
+// biggest difference between rank of a cluster of tree2 and rank of its mrca
+// in the tree of index1
+long rnni_lower_bound(Mrca_Index* index1, Tree* tree2, long* mrcas) {
+    long num_leaves = tree2->num_leaves;
+    long num_nodes = 2 * num_leaves - 1;
+    fill_mrca_array(index1, tree2, mrcas);
+    long bound = 0;
+    for (long i = num_leaves; i < num_nodes; i++) {
+        long difference = labs(mrcas[i] - i);
+        if (difference > bound) {
+            bound = difference;
+        }
+    }
+    return bound;
+}
+
 // return binary matrix with rows representing clusters, columns leaves:
 // 0 if leaf is not in cluster, 1 if it is in cluster
 long** get_clusters(Tree* tree) {
@@ -109,50 +189,131 @@ long** get_clusters(Tree* tree) {
     return clusters;
 }
 
-// Computes sum of sizes of symmetric differences of clusters of tree1 and tree2
-// for all ranks i=1,..,n-1
-long sum_symmetric_cluster_diff(Tree* tree1, Tree* tree2) {
-    long num_leaves = tree1->num_leaves;
+// number of 64-bit words needed for a cluster on num_leaves leaves
+static long cluster_words(long num_leaves) {
+    return (num_leaves + 63) / 64;
+}
 
-    long** clusters_t1 = get_clusters(tree1);
-    long** clusters_t2 = get_clusters(tree2);
+Clusters* new_clusters(Tree* tree) {
+    long num_leaves = tree->num_leaves;
+    Clusters* clusters = malloc(sizeof(Clusters));
+    clusters->num_leaves = num_leaves;
+    clusters->num_words = cluster_words(num_leaves);
+    clusters->bits =
+        malloc((num_leaves - 1) * clusters->num_words * sizeof(uint64_t));
+    fill_clusters(clusters, tree);
+    return clusters;
+}
 
-    // Now compute symmetric difference between clusters (i.e. all columns that
-    // have a 1 in cluster_t1 or cluster_t2 and a 0 in the other matrix)
-    long symm_diff = 0;
-    for (long i = 0; i < num_leaves - 1; i++) {
-        for (long j = 0; j < num_leaves; j++) {
-            if (clusters_t1[i][j] + clusters_t2[i][j] == 1) {
-                symm_diff++;
+// the cluster of a node is the union of the clusters of its children, which
+// have lower ranks, so we can compute all clusters bottom-up
+void fill_clusters(Clusters* clusters, Tree* tree) {
+    long num_leaves = tree->num_leaves;
+    long num_words = clusters->num_words;
+    for (long i = num_leaves; i < 2 * num_leaves - 1; i++) {
+        uint64_t* cluster = &clusters->bits[(i - num_leaves) * num_words];
+        memset(cluster, 0, num_words * sizeof(uint64_t));
+        for (int k = 0; k < 2; k++) {
+            long child = tree->node_array[i].children[k];
+            if (child < num_leaves) {
+                cluster[child / 64] |= (uint64_t)1 << (child % 64);
+            } else {
+                uint64_t* child_cluster =
+                    &clusters->bits[(child - num_leaves) * num_words];
+                for (long w = 0; w < num_words; w++) {
+                    cluster[w] |= child_cluster[w];
+                }
             }
         }
     }
-    free(clusters_t1);
-    free(clusters_t2);
-    return symm_diff;
 }
 
-// Compute symmetric difference of clusters induced by nodes of rank k in tree1
-// and tree2
-long symmetric_cluster_diff(Tree* tree1, Tree* tree2, long k) {
-    long num_leaves = tree1->num_leaves;
-    long** clusters_t1 = get_clusters(tree1);
-    long** clusters_t2 = get_clusters(tree2);
+void free_clusters(Clusters* clusters) {
+    free(clusters->bits);
+    free(clusters);
+}
 
-    // now count the number of entries that are a 1 in either cluster_t1 or
-    // cluster_t2 in row k-num_leaves
-    long output = 0;
-    for (long i = 0; i < num_leaves; i++) {
-        if (clusters_t1[k - num_leaves][i] + clusters_t2[k - num_leaves][i] ==
-            1) {
-            output++;
+// number of bits that differ between the arrays of num_words words a and b
+static long count_different_bits(uint64_t* a, uint64_t* b, long num_words) {
+    long count = 0;
+#pragma omp simd reduction(+ : count)
+    for (long w = 0; w < num_words; w++) {
+        count += __builtin_popcountll(a[w] ^ b[w]);
+    }
+    return count;
+}
+
+long clusters_symmetric_diff(Clusters* clusters1, Clusters* clusters2, long k) {
+    long num_words = clusters1->num_words;
+    long offset = (k - clusters1->num_leaves) * num_words;
+    return count_different_bits(&clusters1->bits[offset],
+                                &clusters2->bits[offset], num_words);
+}
+
+// all clusters are stored in one array, so we compare them all at once
+long clusters_sum_symmetric_diff(Clusters* clusters1, Clusters* clusters2) {
+    return count_different_bits(
+        clusters1->bits, clusters2->bits,
+        (clusters1->num_leaves - 1) * clusters1->num_words);
+}
+
+// Clusters of all trees are computed once (in one array), then pairs are
+// compared in parallel
+int sum_symmetric_cluster_diff_matrix(Tree_Array* tree_array, long* diffs) {
+    long num_trees = tree_array->num_trees;
+    if (num_trees < 2) {
+        return EXIT_SUCCESS;
+    }
+    long num_leaves = tree_array->trees[0].num_leaves;
+    for (long i = 1; i < num_trees; i++) {
+        if (tree_array->trees[i].num_leaves != num_leaves) {
+            printf("Error. The input trees have different numbers of "
+                   "leaves.\n");
+            return EXIT_FAILURE;
         }
     }
-    for (long i = 0; i < num_leaves - 1; i++) {
-        free(clusters_t1[i]);
-        free(clusters_t2[i]);
+    long num_words = cluster_words(num_leaves);
+    long tree_words = (num_leaves - 1) * num_words;
+    uint64_t* bits = malloc(num_trees * tree_words * sizeof(uint64_t));
+    Clusters* all_clusters = malloc(num_trees * sizeof(Clusters));
+#pragma omp parallel for schedule(static)
+    for (long i = 0; i < num_trees; i++) {
+        all_clusters[i].num_leaves = num_leaves;
+        all_clusters[i].num_words = num_words;
+        all_clusters[i].bits = &bits[i * tree_words];
+        fill_clusters(&all_clusters[i], &tree_array->trees[i]);
+    }
+#pragma omp parallel for schedule(dynamic, 1)
+    for (long i = 0; i < num_trees - 1; i++) {
+        for (long j = i + 1; j < num_trees; j++) {
+            diffs[condensed_index(num_trees, i, j)] =
+                clusters_sum_symmetric_diff(&all_clusters[i],
+                                            &all_clusters[j]);
+        }
     }
-    free(clusters_t1);
-    free(clusters_t2);
+    free(all_clusters);
+    free(bits);
+    return EXIT_SUCCESS;
+}
+
+// Computes sum of sizes of symmetric differences of clusters of tree1 and tree2
+// for all ranks i=1,..,n-1
+long sum_symmetric_cluster_diff(Tree* tree1, Tree* tree2) {
+    Clusters* clusters1 = new_clusters(tree1);
+    Clusters* clusters2 = new_clusters(tree2);
+    long symm_diff = clusters_sum_symmetric_diff(clusters1, clusters2);
+    free_clusters(clusters1);
+    free_clusters(clusters2);
+    return symm_diff;
+}
+
+// Compute symmetric difference of clusters induced by nodes of rank k in tree1
+// and tree2
+long symmetric_cluster_diff(Tree* tree1, Tree* tree2, long k) {
+    Clusters* clusters1 = new_clusters(tree1);
+    Clusters* clusters2 = new_clusters(tree2);
+    long output = clusters_symmetric_diff(clusters1, clusters2, k);
+    free_clusters(clusters1);
+    free_clusters(clusters2);
     return output;
-}
\ No newline at end of file
+}
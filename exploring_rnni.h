@@ -1,26 +1,71 @@
 #ifndef EXPLORINGRNNI_H_
 #define EXPLORINGRNNI_H_
 
-#include "rnni.h"
+#include "distances.h"
 
 // Random walk of length k starting at `tree` choosing neighbour uniformly in
 // every step
 long random_walk_distance(Tree* tree, long k);
+// num_walks random walks of length k starting at tree, walk i with random
+// numbers from rng_stream(seed, i). Fills trajectories (num_walks * (k + 1)
+// entries) with the RNNI distance to tree after every step:
+// trajectories[i * (k + 1) + j] is the distance after j steps of walk i
+// (multithreaded)
+int random_walks(Tree* tree,
+                 long num_walks,
+                 long k,
+                 uint64_t seed,
+                 long* trajectories);
 // updates every tree in tree_array to the tree after one iteration of findpath:
 // decreases the mrca of node1 and node2 in every tree until it has rank r
+// (multithreaded)
 int first_iteration_fp(Tree_Array* tree_array, long node1, long node2, long r);
-// sum of squared distances of all trees in tree_array to focal_tree
+// sum of distances of all trees in tree_array to focal_tree (multithreaded, see
+// rnni_distances_to); -1 if trees have different numbers of leaves
 long sos(Tree_Array* tree_array, Tree* focal_tree);
 
 // returns array with rank(mrca_{tree1}(C_i)) at position i where C_i is the
 // cluster induced by node of rank i in tree2
 long* mrca_array(Tree* tree1, Tree* tree2);
+// same as mrca_array, but for tree1 given by its Mrca_Index (which can be
+// reused for many tree2), writing into mrcas (length 2 * num_leaves - 1)
+void fill_mrca_array(Mrca_Index* index1, Tree* tree2, long* mrcas);
 // Sum of differences of ranks of mrcas of all clusters of tree2 between tree1
 // and tree2.
 // Also add differences for parents of leaves if include_leaf_parents == 1
 long mrca_differences(Tree* current_tree,
                       Tree* dest_tree,
                       int include_leaf_parents);
+// lower bound for the RNNI distance between the tree index1 was built for and
+// tree2: every RNNI move changes the rank of the mrca of a cluster by at most
+// one, so the distance is at least the biggest difference between the rank of
+// a cluster of tree2 and the rank of its mrca in tree1. mrcas is space for
+// fill_mrca_array
+long rnni_lower_bound(Mrca_Index* index1, Tree* tree2, long* mrcas);
+
+// Clusters of all internal nodes of a tree as bitsets: bit j of the cluster of
+// the node of rank i is set iff leaf j is in that cluster. Every cluster takes
+// num_words 64-bit words, starting at bits[(i - num_leaves) * num_words]
+typedef struct Clusters {
+    long num_leaves;
+    long num_words;
+    uint64_t* bits;
+} Clusters;
+
+// clusters of tree (computed in one pass over its nodes)
+Clusters* new_clusters(Tree* tree);
+// recompute clusters for tree with the same number of leaves
+void fill_clusters(Clusters* clusters, Tree* tree);
+void free_clusters(Clusters* clusters);
+// size of symmetric difference of the clusters of rank k in clusters1 and
+// clusters2
+long clusters_symmetric_diff(Clusters* clusters1, Clusters* clusters2, long k);
+// sum of clusters_symmetric_diff over all ranks
+long clusters_sum_symmetric_diff(Clusters* clusters1, Clusters* clusters2);
+// Fill diffs (length num_trees * (num_trees - 1) / 2) with
+// sum_symmetric_cluster_diff of all pairs of trees in tree_array, in condensed
+// upper-triangular order (see rnni_distance_matrix). Multithreaded
+int sum_symmetric_cluster_diff_matrix(Tree_Array* tree_array, long* diffs);
 
 // return binary matrix with rows representing clusters, columns leaves:
 // 0 if leaf is not in cluster, 1 if it is in cluster
@@ -0,0 +1,93 @@
+/*Walking along FindPath paths one tree at a time*/
+
+#include "geodesic.h"
+
+Findpath_Cursor* new_findpath_cursor(Tree* start_tree, Tree* dest_tree) {
+    Findpath_Workspace* workspace =
+        new_findpath_workspace(start_tree->num_leaves);
+    Path path = get_empty_path(start_tree->num_leaves);
+    int result =
+        findpath_moves_workspace(start_tree, dest_tree, workspace, &path);
+    free_findpath_workspace(workspace);
+    if (result != EXIT_SUCCESS) {
+        free_path(path);
+        return NULL;
+    }
+    Findpath_Cursor* cursor = malloc(sizeof(Findpath_Cursor));
+    cursor->path = path;
+    cursor->tree = new_tree_copy(start_tree);
+    cursor->position = 0;
+    return cursor;
+}
+
+void free_findpath_cursor(Findpath_Cursor* cursor) {
+    free_path(cursor->path);
+    free_tree(cursor->tree);
+    free(cursor);
+}
+
+Tree* cursor_next(Findpath_Cursor* cursor) {
+    if (cursor->position >= cursor->path.length) {
+        return NULL;
+    }
+    path_apply(cursor->tree, &cursor->path, cursor->position);
+    cursor->position++;
+    return cursor->tree;
+}
+
+Tree* cursor_prev(Findpath_Cursor* cursor) {
+    if (cursor->position <= 0) {
+        return NULL;
+    }
+    cursor->position--;
+    path_undo(cursor->tree, &cursor->path, cursor->position);
+    return cursor->tree;
+}
+
+Tree* cursor_seek(Findpath_Cursor* cursor, long k) {
+    if (k < 0 || k > cursor->path.length) {
+        printf("Error. Position %ld is not on a path of length %ld.\n", k,
+               cursor->path.length);
+        return NULL;
+    }
+    while (cursor->position < k) {
+        cursor_next(cursor);
+    }
+    while (cursor->position > k) {
+        cursor_prev(cursor);
+    }
+    return cursor->tree;
+}
+
+// data for copy_tree_at: copy tree at position k into result
+typedef struct Tree_At {
+    long k;
+    Tree* result;
+} Tree_At;
+
+static int copy_tree_at(Tree* tree,
+                        long position,
+                        unsigned int move,
+                        void* data) {
+    Tree_At* tree_at = data;
+    if (position == tree_at->k) {
+        copy_tree(tree_at->result, tree);
+        return 1;
+    }
+    return 0;
+}
+
+int findpath_tree(Tree* start_tree, Tree* dest_tree, long k, Tree* result) {
+    if (result->num_leaves != start_tree->num_leaves) {
+        printf("Error. result needs to have as many leaves as start tree.\n");
+        return EXIT_FAILURE;
+    }
+    Tree_At tree_at = {k, result};
+    long num_moves = findpath_visit(start_tree, dest_tree, copy_tree_at,
+                                    &tree_at);
+    if (num_moves != k) {
+        printf("Error. Position %ld is not on FindPath path.\n", k);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,31 @@
+#ifndef GEODESIC_H_
+#define GEODESIC_H_
+
+#include "rnni.h"
+
+// Cursor on the FindPath path from a start tree to a dest tree. Only the moves
+// of the path (one unsigned int each) and one tree are kept in memory, and
+// the cursor tree is changed in place by one move per step
+typedef struct Findpath_Cursor {
+    Path path;
+    Tree* tree;     // tree at position on path (owned by cursor)
+    long position;  // number of moves of path done on tree (0 -> start tree)
+} Findpath_Cursor;
+
+// cursor at the start tree of the FindPath path from start_tree to dest_tree;
+// NULL if the trees have different numbers of leaves
+Findpath_Cursor* new_findpath_cursor(Tree* start_tree, Tree* dest_tree);
+void free_findpath_cursor(Findpath_Cursor* cursor);
+// move cursor one tree towards dest tree / start tree. Return cursor->tree,
+// or NULL (without moving) if cursor is already at the end / start of path
+Tree* cursor_next(Findpath_Cursor* cursor);
+Tree* cursor_prev(Findpath_Cursor* cursor);
+// move cursor to the tree after k moves on path and return it; NULL if k is
+// not between 0 and path length
+Tree* cursor_seek(Findpath_Cursor* cursor, long k);
+
+// copy tree after k moves on the FindPath path from start_tree to dest_tree
+// into result without saving the path (uses findpath_visit)
+int findpath_tree(Tree* start_tree, Tree* dest_tree, long k, Tree* result);
+
+#endif
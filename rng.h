@@ -0,0 +1,48 @@
+#ifndef RNG_H_
+#define RNG_H_
+
+#include <stdint.h>
+
+/* Counter-based random number generator (splitmix64): the i-th number of a
+stream only depends on seed, stream and i. Giving every walk (or simulated
+tree) its own stream makes results reproducible independently of the number of
+threads, and a stream is just two integers, so it costs nothing to create one
+*/
+typedef struct Rng {
+    uint64_t key;      // derived from seed and stream
+    uint64_t counter;  // number of values drawn so far
+} Rng;
+
+#define RNG_GAMMA 0x9e3779b97f4a7c15ULL
+
+static inline uint64_t rng_mix(uint64_t z) {
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+// random number stream number stream for seed
+static inline Rng rng_stream(uint64_t seed, uint64_t stream) {
+    Rng rng;
+    rng.key = rng_mix(rng_mix(seed) + stream * RNG_GAMMA);
+    rng.counter = 0;
+    return rng;
+}
+
+// next uniformly random 64 bit integer of stream
+static inline uint64_t rng_next(Rng* rng) {
+    rng->counter++;
+    return rng_mix(rng->key + rng->counter * RNG_GAMMA);
+}
+
+// uniformly random integer in [0, bound) (bound > 0), without modulo bias
+static inline long rng_below(Rng* rng, long bound) {
+    uint64_t limit = UINT64_MAX - UINT64_MAX % (uint64_t)bound;
+    uint64_t x;
+    do {
+        x = rng_next(rng);
+    } while (x >= limit);
+    return (long)(x % (uint64_t)bound);
+}
+
+#endif
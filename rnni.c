@@ -2,6 +2,8 @@
 
 #include "rnni.h"
 
+#include "compact.h"
+
 // NNI move on edge bounded by nodes at position r and r + 1
 // moves child_moves_up (index -- 0 or 1) of the lower node up
 // i.e. tree.node_array[r].children[child_moves_up] has parent of rank r+1 after
@@ -76,264 +78,567 @@ int rank_move(Tree* tree, long r) {
     return EXIT_SUCCESS;
 }
 
-// Use length moves to move up internal nodes between lowest_moving_node
-// (including) and k (excluding) in tree.node_array in the end there are no
-// nodes with rank less than k in the tree these are length moves that move
-// nodes up -- see pseudocode FindPath^+ in DCT paper
-int move_up(Tree* tree, long lowest_moving_node, long k) {
+// move_up, adding the length moves on every node as one run to path (if path
+// is not NULL). Runs start with the highest node, so that the times of all
+// trees on the path are increasing along ranks
+static long move_up_runs(Tree* tree,
+                         long lowest_moving_node,
+                         long k,
+                         Path* path) {
     long num_nodes = 2 * tree->num_leaves - 1;
     long num_moves = 0;  // counter for the number of moves that are necessary
     long highest_moving_node = lowest_moving_node;
     // Find highest j that needs to be moved up -- maximum is reached at root!
-    while (tree->node_array[highest_moving_node + 1].time <= k &&
-           highest_moving_node + 1 <= num_nodes - 1) {
+    while (highest_moving_node + 1 <= num_nodes - 1 &&
+           tree->node_array[highest_moving_node + 1].time <= k) {
         highest_moving_node++;
     }
     long num_moving_nodes = highest_moving_node - lowest_moving_node;
     // number of nodes that will need to be moved
     // Find the uppermost node that needs to move up
-    while (tree->node_array[highest_moving_node + 1].time <=
-               k + num_moving_nodes &&
-           highest_moving_node + 1 <= num_nodes - 1) {
+    while (highest_moving_node + 1 <= num_nodes - 1 &&
+           tree->node_array[highest_moving_node + 1].time <=
+               k + num_moving_nodes) {
         highest_moving_node++;
         num_moving_nodes++;
     }
     // Update times of nodes (moving_node) between i and highest_moving_node to
     // k+moving_node-i
-    for (long moving_node = lowest_moving_node;
-         moving_node <= highest_moving_node;
-         moving_node++) {  // Do all required length moves
-        num_moves += k + moving_node - lowest_moving_node -
+    for (long moving_node = highest_moving_node;
+         moving_node >= lowest_moving_node;
+         moving_node--) {  // Do all required length moves
+        long delta = k + moving_node - lowest_moving_node -
                      tree->node_array[moving_node].time;
-        tree->node_array[moving_node].time =
-            k + moving_node - lowest_moving_node;
+        num_moves += delta;
+        tree->node_array[moving_node].time += delta;
+        if (path != NULL && delta != 0) {
+            path_push_length(path, moving_node, delta);
+        }
     }
+    COUNT(length_moves, num_moves);
     return num_moves;
 }
 
+// Use length moves to move up internal nodes between lowest_moving_node
+// (including) and k (excluding) in tree.node_array in the end there are no
+// nodes with rank less than k in the tree these are length moves that move
+// nodes up -- see pseudocode FindPath^+ in DCT paper
+int move_up(Tree* tree, long lowest_moving_node, long k) {
+    return move_up_runs(tree, lowest_moving_node, k, NULL);
+}
+
 // Compute Tree_Array of all RNNI neighbours
 Tree_Array rnni_neighbourhood(Tree* tree) {
+    Tree_Array neighbour_array = get_empty_tree_array(0, tree->num_leaves);
+    fill_rnni_neighbourhood(tree, &neighbour_array);
+    return (neighbour_array);
+}
+
+// Fill neighbour_array with all RNNI neighbours of tree, reusing its memory
+void fill_rnni_neighbourhood(Tree* tree, Tree_Array* neighbour_array) {
     long num_leaves = tree->num_leaves;
     long num_nodes = 2 * num_leaves - 1;
     long max_nh_size = 2 * (num_leaves - 1);
 
-    Tree_Array neighbour_array = get_empty_tree_array(max_nh_size, num_leaves);
+    reset_tree_array(neighbour_array, max_nh_size, num_leaves);
     long index = 0;  // index to the currently last element in neighbour_array
 
-    // Deep copy input tree to get neighbouring trees
-    Tree* neighbour = new_tree_copy(tree);
-    Tree* next_neighbour_array;
-    next_neighbour_array = &neighbour_array.trees[index];
-
     // Loop through all possible ranks on which moves can happen
     // 'ranks' here means position in node array, where the first n entries are
     // leaves
+    // Every neighbour is created by copying tree to its position in
+    // neighbour_array and doing the move there
     for (long r = num_leaves; r < num_nodes - 1; r++) {
         if (tree->node_array[r].parent != r + 1) {
             // no edge -> rank move:
-            rank_move(neighbour, r);
-            copy_tree(next_neighbour_array, neighbour);
+            copy_tree(&neighbour_array->trees[index], tree);
+            rank_move(&neighbour_array->trees[index], r);
             index++;
-            next_neighbour_array = &neighbour_array.trees[index];
-            copy_tree(neighbour, tree);
         } else {
             // edge -> 2 NNI moves
             for (long child_moves_up = 0; child_moves_up < 2;
                  child_moves_up++) {
-                nni_move(neighbour, r, child_moves_up);
-                copy_tree(next_neighbour_array, neighbour);
+                copy_tree(&neighbour_array->trees[index], tree);
+                nni_move(&neighbour_array->trees[index], r, child_moves_up);
                 index++;
-                next_neighbour_array = &neighbour_array.trees[index];
-                copy_tree(neighbour, tree);
             }
         }
     }
-    neighbour_array.num_trees = index;
-    free_tree(neighbour);
-    return (neighbour_array);
+    neighbour_array->num_trees = index;
+}
+
+// List all RNNI moves on tree in moves (same order as rnni_neighbourhood)
+long rnni_moves(Tree* tree, Move* moves) {
+    long num_leaves = tree->num_leaves;
+    long num_moves = 0;
+    for (long r = num_leaves; r < 2 * num_leaves - 2; r++) {
+        if (tree->node_array[r].parent != r + 1) {
+            moves[num_moves].type = MOVE_RANK;
+            moves[num_moves].rank = r;
+            moves[num_moves].child = -1;
+            moves[num_moves].new_sibling = -1;
+            moves[num_moves].old_sibling = -1;
+            num_moves++;
+        } else {
+            for (int child = 0; child < 2; child++) {
+                moves[num_moves].type = MOVE_NNI;
+                moves[num_moves].rank = r;
+                moves[num_moves].child = child;
+                moves[num_moves].new_sibling = -1;
+                moves[num_moves].old_sibling = -1;
+                num_moves++;
+            }
+        }
+    }
+    return num_moves;
+}
+
+// do RNNI move on tree -- doing it a second time undoes it
+static int rnni_move(Tree* tree, Move* move) {
+    if (move->type == MOVE_RANK) {
+        return rank_move(tree, move->rank);
+    }
+    return nni_move(tree, move->rank, move->child);
+}
+
+// do move, call visit on the resulting tree, and undo move again. Returns the
+// return value of visit
+static int visit_rnni_move(Tree* tree,
+                           Move* move,
+                           Move_Visitor visit,
+                           void* data) {
+    rnni_move(tree, move);
+    int stop = visit(tree, move, data);
+    rnni_move(tree, move);
+    return stop;
+}
+
+// Visit all RNNI neighbours of tree (same order as rnni_neighbourhood) by doing
+// every move in place, calling visit, and undoing the move
+long visit_rnni_neighbourhood(Tree* tree, Move_Visitor visit, void* data) {
+    long num_leaves = tree->num_leaves;
+    long num_visited = 0;
+    Move move;
+    move.new_sibling = -1;
+    move.old_sibling = -1;
+    for (long r = num_leaves; r < 2 * num_leaves - 2; r++) {
+        move.rank = r;
+        if (tree->node_array[r].parent != r + 1) {
+            move.type = MOVE_RANK;
+            move.child = -1;
+            num_visited++;
+            if (visit_rnni_move(tree, &move, visit, data) != 0) {
+                return num_visited;
+            }
+        } else {
+            move.type = MOVE_NNI;
+            for (int child = 0; child < 2; child++) {
+                move.child = child;
+                num_visited++;
+                if (visit_rnni_move(tree, &move, visit, data) != 0) {
+                    return num_visited;
+                }
+            }
+        }
+    }
+    return num_visited;
 }
 
 // Compute Tree_Array of all rank neighbours
 Tree_Array rank_neighbourhood(Tree* tree) {
+    Tree_Array neighbour_array = get_empty_tree_array(0, tree->num_leaves);
+    fill_rank_neighbourhood(tree, &neighbour_array);
+    return (neighbour_array);
+}
+
+// Fill neighbour_array with all rank neighbours of tree, reusing its memory
+void fill_rank_neighbourhood(Tree* tree, Tree_Array* neighbour_array) {
     long num_leaves = tree->num_leaves;
     long max_nh_size = num_leaves - 1;
 
-    Tree_Array neighbour_array = get_empty_tree_array(max_nh_size, num_leaves);
-    Tree* neighbour = new_tree_copy(tree);
+    reset_tree_array(neighbour_array, max_nh_size, num_leaves);
 
     // index to the currently last element in neighbour_array
     long index = 0;
-    Tree* next_neighbour_array_tree;
-    next_neighbour_array_tree = &neighbour_array.trees[index];
     for (long r = num_leaves; r < 2 * num_leaves - 2; r++) {
         // Check if we can do rank move:
         if (tree->node_array[r].parent != r + 1) {
-            rank_move(neighbour, r);
-            copy_tree(next_neighbour_array_tree, neighbour);
+            copy_tree(&neighbour_array->trees[index], tree);
+            rank_move(&neighbour_array->trees[index], r);
             index++;
-            // reset neighbour & update pointer to next neighbour in array
-            copy_tree(neighbour, tree);
-            next_neighbour_array_tree = &neighbour_array.trees[index];
         }
     }
-    neighbour_array.num_trees = index;
-    free_tree(neighbour);
-    return (neighbour_array);
+    neighbour_array->num_trees = index;
 }
 
 // Perform a random RNNI move (at uniform) on tree
-void uniform_neighbour(Tree* tree) {
+int uniform_neighbour(Tree* tree) {
+    Rng rng = rng_stream(rand(), 0);
+    return uniform_neighbour_rng(tree, &rng, NULL);
+}
+
+// Perform a random RNNI move (at uniform) on tree in O(1) expected time:
+// every interval [r, r+1] has three slots for moves, the first one for the
+// rank move and the other two for the NNI moves, of which either the first or
+// the other two are possible. We draw slots uniformly until we hit a possible
+// move, which takes at most three draws on average
+int uniform_neighbour_rng(Tree* tree, Rng* rng, Move* move) {
     long num_leaves = tree->num_leaves;
-    long num_nodes = 2 * num_leaves - 1;
-    long num_moves = 0;
-    long max_nh_size = 2 * (num_leaves - 1);
+    long num_intervals = num_leaves - 2;
+    if (num_intervals < 1) {
+        printf("Error. There are no RNNI moves on trees with %ld leaves.\n",
+               num_leaves);
+        return EXIT_FAILURE;
+    }
+    Move random_move;
+    random_move.new_sibling = -1;
+    random_move.old_sibling = -1;
+    while (TRUE) {
+        long slot = rng_below(rng, 3 * num_intervals);
+        long r = num_leaves + slot / 3;
+        int is_edge = (tree->node_array[r].parent == r + 1);
+        if (slot % 3 == 0 && !is_edge) {
+            random_move.type = MOVE_RANK;
+            random_move.child = -1;
+        } else if (slot % 3 != 0 && is_edge) {
+            random_move.type = MOVE_NNI;
+            random_move.child = slot % 3 - 1;
+        } else {
+            continue;
+        }
+        random_move.rank = r;
+        break;
+    }
+    rnni_move(tree, &random_move);
+    if (move != NULL) {
+        *move = random_move;
+    }
+    return EXIT_SUCCESS;
+}
 
-    // moves are saved in matrix -- ith move in move_array[i]
-    // move_array[i][0] -- rank of lower node of edge for move
-    // move_array[i][1] -- 0 for rank move
-    // 1 for NNI move with children[0] moves up
-    // 2 for NNI move with children[1] moves up
-    int** move_array = calloc(max_nh_size, sizeof(int*));
-    for (long i = 0; i < max_nh_size; i++) {
-        move_array[i][0] = -1;  // lower node of edge for move
-        move_array[i][1] = -1;  // rank vs nni move
-    }
-    // Fill move array
-    for (long i = num_leaves; i < num_nodes; i++) {
-        if (tree->node_array[i].parent == i + 1) {
-            move_array[num_moves][0] = i;
-            move_array[num_moves][1] = 1;  // NNI move 0
-            move_array[num_moves + 1][0] = i;
-            move_array[num_moves + 1][1] = 2;  // NNI move 1
-            num_moves += 2;
+// Create workspace for FINDPATH on trees with up to max_leaves leaves
+Findpath_Workspace* new_findpath_workspace(long max_leaves) {
+    COUNT(allocations, 1);
+    Findpath_Workspace* workspace = malloc(sizeof(Findpath_Workspace));
+    workspace->max_leaves = max_leaves;
+    workspace->tree = get_empty_tree(max_leaves);
+    for (int k = 0; k < 2; k++) {
+        workspace->ancestors[k] = malloc((2 * max_leaves - 1) * sizeof(long));
+        workspace->num_ancestors[k] = 0;
+    }
+    workspace->reference = malloc(sizeof(Reference_Tree));
+    workspace->reference->max_leaves = max_leaves;
+    workspace->reference->num_leaves = 0;
+    workspace->reference->nodes = malloc(max_leaves * sizeof(Reference_Node));
+    workspace->compact = NULL;
+    if (compact_width(max_leaves) > 0) {
+        workspace->compact = malloc(compact_memory_size(max_leaves));
+    }
+    return workspace;
+}
+
+void free_findpath_workspace(Findpath_Workspace* workspace) {
+    free_tree(workspace->tree);
+    free(workspace->ancestors[0]);
+    free(workspace->ancestors[1]);
+    free_reference_tree(workspace->reference);
+    free(workspace->compact);
+    free(workspace);
+}
+
+// copy start_tree into workspace->tree to get the tree FINDPATH works on
+// returns NULL if the trees don't fit into workspace
+static Tree* workspace_copy(Findpath_Workspace* workspace,
+                            Tree* start_tree,
+                            long dest_leaves) {
+    if (start_tree->num_leaves != dest_leaves) {
+        printf("Error. The input trees have different numbers of leaves.\n");
+        return NULL;
+    }
+    if (start_tree->num_leaves > workspace->max_leaves) {
+        printf("Error. The input trees are too big for the workspace.\n");
+        return NULL;
+    }
+    workspace->tree->num_leaves = start_tree->num_leaves;
+    copy_tree(workspace->tree, start_tree);
+    return workspace->tree;
+}
+
+// Empty path with space for capacity moves (grows when needed)
+Path get_empty_path(long capacity) {
+    Path path;
+    if (capacity < 1) {
+        capacity = 1;
+    }
+    COUNT(allocations, 1);
+    path.moves = malloc(capacity * sizeof(unsigned int));
+    path.length = 0;
+    path.capacity = capacity;
+    path.length_moves = NULL;
+    path.num_length_moves = 0;
+    path.length_capacity = 0;
+    return path;
+}
+
+void free_path(Path path) {
+    free(path.moves);
+    free(path.length_moves);
+}
+
+// append move of given type on interval [r, r+1] to path
+void path_push(Path* path, long r, int type) {
+    if (path->length == path->capacity) {
+        COUNT(allocations, 1);
+        path->capacity *= 2;
+        path->moves =
+            realloc(path->moves, path->capacity * sizeof(unsigned int));
+    }
+    path->moves[path->length] = PATH_MOVE(r, type);
+    path->length++;
+}
+
+// append run of length moves on the node of rank r to path
+void path_push_length(Path* path, long r, long delta) {
+    if (path->num_length_moves == path->length_capacity) {
+        COUNT(allocations, 1);
+        path->length_capacity =
+            (path->length_capacity > 0) ? 2 * path->length_capacity : 16;
+        path->length_moves =
+            realloc(path->length_moves,
+                    path->length_capacity * sizeof(Length_Move));
+    }
+    path->length_moves[path->num_length_moves].rank = r;
+    path->length_moves[path->num_length_moves].delta = delta;
+    path_push(path, path->num_length_moves, PATH_LENGTH_MOVE);
+    path->num_length_moves++;
+}
+
+// change time of the node of rank r by delta, if it stays between the times
+// of the nodes of rank r - 1 and r + 1
+static int length_move(Tree* tree, long r, long delta) {
+    long time = tree->node_array[r].time + delta;
+    if (time <= tree->node_array[r - 1].time ||
+        (r < 2 * tree->num_leaves - 2 &&
+         time >= tree->node_array[r + 1].time)) {
+        printf("Error. No length move possible. Time %ld of node %ld is "
+               "not between the times of its neighbours!\n",
+               time, r);
+        return EXIT_FAILURE;
+    }
+    tree->node_array[r].time = time;
+    return EXIT_SUCCESS;
+}
+
+// do move i of path on tree
+int path_apply(Tree* tree, Path* path, long i) {
+    long r = PATH_MOVE_RANK(path->moves[i]);
+    int type = PATH_MOVE_TYPE(path->moves[i]);
+    if (type == 0) {
+        return rank_move(tree, r);
+    } else if (type == PATH_LENGTH_MOVE) {
+        return length_move(tree, path->length_moves[r].rank,
+                           path->length_moves[r].delta);
+    }
+    return nni_move(tree, r, type - 1);
+}
+
+// RNNI moves undo themselves (see path_inverse), runs of length moves are
+// undone by the opposite change of time
+int path_undo(Tree* tree, Path* path, long i) {
+    long r = PATH_MOVE_RANK(path->moves[i]);
+    if (PATH_MOVE_TYPE(path->moves[i]) == PATH_LENGTH_MOVE) {
+        return length_move(tree, path->length_moves[r].rank,
+                           -path->length_moves[r].delta);
+    }
+    return path_apply(tree, path, i);
+}
+
+long path_distance(Path* path) {
+    long distance = path->length - path->num_length_moves;
+    for (long j = 0; j < path->num_length_moves; j++) {
+        long delta = path->length_moves[j].delta;
+        distance += (delta < 0) ? -delta : delta;
+    }
+    return distance;
+}
+
+// do all moves of path on tree, in order
+int path_replay(Tree* tree, Path* path) {
+    for (long i = 0; i < path->length; i++) {
+        if (path_apply(tree, path, i) != EXIT_SUCCESS) {
+            return EXIT_FAILURE;
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+// path in reverse direction: every RNNI move is undone by doing the same move
+// again (for NNI moves the node that moved up is at the same child index of
+// the lower node afterwards), so we only need to reverse the order of moves
+// and the direction of runs of length moves
+Path path_inverse(Path* path) {
+    Path inverse = get_empty_path(path->length);
+    for (long i = 0; i < path->length; i++) {
+        unsigned int move = path->moves[path->length - 1 - i];
+        if (PATH_MOVE_TYPE(move) == PATH_LENGTH_MOVE) {
+            Length_Move* run = &path->length_moves[PATH_MOVE_RANK(move)];
+            path_push_length(&inverse, run->rank, -run->delta);
         } else {
-            move_array[num_moves][0] = i;
-            move_array[num_moves][1] = 0;  // rank move is 0
-            num_moves += 1;
+            path_push(&inverse, PATH_MOVE_RANK(move), PATH_MOVE_TYPE(move));
         }
     }
+    return inverse;
+}
 
-    // Pick random move
-    long r = rand() % (num_moves - 1);
-    if (move_array[r][1] == 0) {
-        rank_move(tree, move_array[r][0]);
-    } else if (move_array[r][1] == 1) {
-        nni_move(tree, move_array[r][0], 0);
-    } else {
-        nni_move(tree, move_array[r][0], 1);
+// returns the child of node r that is node or an ancestor of node, -1 if node
+// is not a descendant of r
+static long child_towards(Tree* tree, long r, long node) {
+    long parent = tree->node_array[node].parent;
+    // ranks increase along the path to the root, so we can stop as soon as we
+    // pass r
+    while (parent != -1 && parent < r) {
+        node = parent;
+        parent = tree->node_array[node].parent;
     }
-    // free move_array
-    free(move_array);
+    return (parent == r) ? node : -1;
 }
 
 // decrease the mrca of node1 and node2 in tree by a (unique) RNNI move
 // returns 0 if rank move was done
 // returns 1 if NNI move moving children[0] up
 // returns 2 if NNI move moving children[1] up
+// The move is done in place: if the interval below the mrca is an edge, the
+// child of the lower node that contains node1 or node2 has to stay below the
+// lower node, so the other child moves up
 int decrease_mrca(Tree* tree, long node1, long node2) {
-    // return value:
-    int move_type;
+    COUNT(decrease_mrca, 1);
     long current_mrca = mrca(tree, node1, node2);
-    // deep copy tree
-    Tree* neighbour = new_tree_copy(tree);
-    if (neighbour->node_array[current_mrca - 1].parent == current_mrca) {
-        // we try both possible NNI move and see which one decreases the rank of
-        // the mrca
-        move_type = 1;
-        nni_move(neighbour, current_mrca - 1, 0);
-        if (mrca(neighbour, node1, node2) >= current_mrca) {
-            // we did not decrease the rank of the mrca by this nni move, so we
-            // need to do the other one but first we need to reset neighbour to
-            // tree:
-            copy_tree(neighbour, tree);
-            nni_move(neighbour, current_mrca - 1, 1);
-            move_type = 2;
+    long lower_node = current_mrca - 1;
+    if (tree->node_array[lower_node].parent == current_mrca) {
+        long child_staying = child_towards(tree, lower_node, node1);
+        if (child_staying == -1) {
+            child_staying = child_towards(tree, lower_node, node2);
         }
-    } else {  // otherwise, we make a rank move
-        rank_move(neighbour, current_mrca - 1);
-        move_type = 0;
-    }
-    // now update tree to become neighbour
-    copy_tree(tree, neighbour);
-    free_tree(neighbour);
-    return move_type;
-}
-
-// FINDPATH. returns a shortest RNNI path in matrix representation:
-// each row of path is move
-// path[i][0]: rank of lower node bounding the interval of move i
-// path[i][1]:
-// 0 -> rank move
-// 1 -> nni where children[0] moves up (becomes child of node at rank
-// path[i][0]+1) 2 -> nni where children[1] moves up (becomes child of node at
-// rank path[i][0]+1)
-// Only works for RNNI, not DCT!
-Path findpath_moves(Tree* start_tree, Tree* dest_tree) {
-    long num_leaves = start_tree->num_leaves;
-    long num_nodes = 2 * num_leaves - 1;
-    long max_dist = ((num_leaves - 1) * (num_leaves - 2)) / 2;
-    Path path;
-    path.moves = malloc((max_dist + 1) * sizeof(long*));
-    for (long i = 0; i < max_dist + 1; i++) {
-        path.moves[i] = malloc(2 * sizeof(long));
-        path.moves[i][0] = 0;
-        path.moves[i][1] = 0;
+        if (tree->node_array[lower_node].children[0] == child_staying) {
+            nni_move(tree, lower_node, 1);
+            return 2;
+        }
+        nni_move(tree, lower_node, 0);
+        return 1;
     }
+    // otherwise, we make a rank move
+    rank_move(tree, lower_node);
+    return 0;
+}
 
-    if (start_tree->num_leaves != dest_tree->num_leaves) {
-        printf("Error. The input trees have different numbers of leaves.\n");
-        return path;
+// mrca of node1 and node2 in tree, saving the nodes on the paths from node1
+// and node2 up to (excluding) the mrca in workspace->ancestors[0] and [1]
+// (bottom-up), so that the top of each is a child of the mrca
+static long track_mrca(Tree* tree,
+                       long node1,
+                       long node2,
+                       Findpath_Workspace* workspace) {
+    long* ancestors1 = workspace->ancestors[0];
+    long* ancestors2 = workspace->ancestors[1];
+    long num_ancestors1 = 0;
+    long num_ancestors2 = 0;
+    // same walk as in mrca()
+    while (node1 != node2) {
+        COUNT(mrca_steps, 1);
+        if (node1 < node2) {
+            ancestors1[num_ancestors1++] = node1;
+            node1 = tree->node_array[node1].parent;
+        } else {
+            ancestors2[num_ancestors2++] = node2;
+            node2 = tree->node_array[node2].parent;
+        }
     }
-    long path_index =
-        0;  // next position on path that we want to fill with a tree pointer
-    long current_mrca;  // rank of the mrca that needs to be moved down
-    Tree* current_tree = new_tree_copy(start_tree);
-    // loop through internal nodes, construct cluster of node at position i in
-    // iteration i
-    for (long i = num_leaves; i < num_nodes; i++) {
-        current_mrca = mrca(current_tree, dest_tree->node_array[i].children[0],
-                            dest_tree->node_array[i].children[1]);
-        // decreases current_mrca until it becomes i
-        while (current_mrca != i) {
-            path.moves[path_index][0] = current_mrca - 1;
-            path.moves[path_index][1] = decrease_mrca(
-                current_tree, dest_tree->node_array[i].children[0],
-                dest_tree->node_array[i].children[1]);
-            path_index++;
-            current_mrca--;
+    workspace->num_ancestors[0] = num_ancestors1;
+    workspace->num_ancestors[1] = num_ancestors2;
+    return node1;
+}
+
+// decrease_mrca for the nodes tracked by track_mrca, whose mrca is
+// current_mrca. Instead of searching for the child that has to stay below the
+// lower node of an NNI move, we take it from the saved ancestors, so every move
+// takes constant time
+static int decrease_tracked_mrca(Tree* tree,
+                                 long current_mrca,
+                                 Findpath_Workspace* workspace) {
+    COUNT(decrease_mrca, 1);
+    long lower_node = current_mrca - 1;
+    if (tree->node_array[lower_node].parent != current_mrca) {
+        // rank move -- the ancestors are all below lower_node and don't change
+        rank_move(tree, lower_node);
+        return 0;
+    }
+    // lower_node is one of the children of current_mrca, i.e. on top of one of
+    // the ancestor lists; its next entry is the child that stays below it.
+    // After the NNI move the tops of both lists are children of the new mrca
+    // (lower_node)
+    int k = (workspace->num_ancestors[0] > 0 &&
+             workspace->ancestors[0][workspace->num_ancestors[0] - 1] ==
+                 lower_node)
+                ? 0
+                : 1;
+    workspace->num_ancestors[k]--;
+    long child_staying =
+        workspace->ancestors[k][workspace->num_ancestors[k] - 1];
+    if (tree->node_array[lower_node].children[0] == child_staying) {
+        nni_move(tree, lower_node, 1);
+        return 2;
+    }
+    nni_move(tree, lower_node, 0);
+    return 1;
+}
+
+// write children and times of internal nodes of tree into reference (which
+// needs to have space for tree)
+void fill_reference_tree(Reference_Tree* reference, Tree* tree) {
+    long num_leaves = tree->num_leaves;
+    reference->num_leaves = num_leaves;
+    reference->ranked = TRUE;
+    for (long i = num_leaves; i < 2 * num_leaves - 1; i++) {
+        Reference_Node* node = &reference->nodes[i - num_leaves];
+        node->children[0] = tree->node_array[i].children[0];
+        node->children[1] = tree->node_array[i].children[1];
+        node->time = tree->node_array[i].time;
+        if (node->time != i - num_leaves + 1) {
+            reference->ranked = FALSE;
         }
     }
-    free_tree(current_tree);
-    path.length = path_index;
-    return path;
 }
 
-// FINDPATH without saving the path -- returns only the distance
-// This implementation works for discrete coalesent trees DCT
-long rnni_distance(Tree* start_tree, Tree* dest_tree) {
-    long num_leaves = start_tree->num_leaves;
+// FindPath^+ for DCTs on current_tree (a copy of the start tree) as in
+// reference_distance_bounded, adding all moves to path (if path is not NULL)
+static long dct_findpath(Tree* current_tree,
+                         Reference_Tree* reference,
+                         long bound,
+                         Findpath_Workspace* workspace,
+                         Path* path) {
+    long num_leaves = reference->num_leaves;
     long num_nodes = 2 * num_leaves - 1;
     long path_length = 0;
-    if (dest_tree->num_leaves != start_tree->num_leaves) {
-        printf("Error. The input trees have different numbers of leaves.\n");
-        return EXIT_FAILURE;
-    }
     long current_mrca_rank;  // rank of the mrca that needs to be moved down
-    Tree* current_tree = new_tree_copy(start_tree);
+    Reference_Node* dest_node;  // node of rank i in dest tree
+
     // loop through internal nodes, construct cluster of node at position i in
     // iteration i
     for (long i = num_leaves; i < num_nodes; i++) {
+        dest_node = &reference->nodes[i - num_leaves];
+        long dest_time = dest_node->time;
         // if needed: length moves moving all nodes up that shouldn't be below
         // node i in dest_tree (this cannot happen in RNNI)
-        if (current_tree->node_array[i].time < dest_tree->node_array[i].time) {
-            path_length +=
-                move_up(current_tree, i, dest_tree->node_array[i].time);
+        if (current_tree->node_array[i].time < dest_time) {
+            path_length += move_up_runs(current_tree, i, dest_time, path);
         }
         // find mrca of children of currently considered node (i) -> current
         // mrca
-        current_mrca_rank =
-            mrca(current_tree, dest_tree->node_array[i].children[0],
-                 dest_tree->node_array[i].children[1]);
+        PHASE_START(mrca_start);
+        current_mrca_rank = track_mrca(current_tree, dest_node->children[0],
+                                       dest_node->children[1], workspace);
+        PHASE_END(mrca_ns, mrca_start);
+        PHASE_START(moves_start);
         Node* current_mrca;
         current_mrca = &current_tree->node_array[current_mrca_rank];
         Node* node_below_current_mrca;  // node with rank one less than
@@ -342,69 +647,320 @@ long rnni_distance(Tree* start_tree, Tree* dest_tree) {
             &current_tree->node_array[current_mrca_rank - 1];
         // decrease time of current_mrca until it reaches the time it has in
         // dest_tree
-        while (current_mrca->time != dest_tree->node_array[i].time) {
+        while (current_mrca->time != dest_time) {
             // first length moves (if needed) to decrease time of current_mrca
             if (node_below_current_mrca->time < current_mrca->time - 1) {
                 // check if current_mrca needs to move past
                 // node_below_current_mrca if so, we need to move current_mrca
                 // down to node_below_current_mrca and then do RNNI moves
-                if (node_below_current_mrca->time + 1 >
-                    dest_tree->node_array[i].time) {
-                    path_length += current_mrca->time -
-                                   (node_below_current_mrca->time + 1);
-                    current_mrca->time = node_below_current_mrca->time + 1;
-                } else {
+                long time = node_below_current_mrca->time + 1;
+                if (time <= dest_time) {
                     // in this case we move the node i to its final position
-                    path_length +=
-                        current_mrca->time - dest_tree->node_array[i].time;
-                    current_mrca->time = dest_tree->node_array[i].time;
+                    time = dest_time;
+                }
+                path_length += current_mrca->time - time;
+                if (path != NULL) {
+                    path_push_length(path, current_mrca_rank,
+                                     time - current_mrca->time);
+                }
+                current_mrca->time = time;
+                if (time == dest_time) {
                     break;
                 }
             }
             // now one RNNI move
-            decrease_mrca(current_tree, dest_tree->node_array[i].children[0],
-                          dest_tree->node_array[i].children[1]);
+            int move_type = decrease_tracked_mrca(current_tree,
+                                                  current_mrca_rank, workspace);
+            if (path != NULL) {
+                path_push(path, current_mrca_rank - 1, move_type);
+            }
             current_mrca_rank--;
             current_mrca = &current_tree->node_array[current_mrca_rank];
-            node_below_current_mrca = &current_tree->node_array[current_mrca_rank - 1];
+            node_below_current_mrca =
+                &current_tree->node_array[current_mrca_rank - 1];
             path_length++;
         }
+        PHASE_END(moves_ns, moves_start);
+        if (path_length > bound) {
+            return bound + 1;
+        }
     }
-    free_tree(current_tree);
     return path_length;
 }
 
+// FINDPATH. returns a shortest RNNI path (see Path for the encoding of moves),
+// or FindPath^+ path with runs of length moves for DCTs
+Path findpath_moves(Tree* start_tree, Tree* dest_tree) {
+    Path path = get_empty_path(start_tree->num_leaves);
+    Findpath_Workspace* workspace =
+        new_findpath_workspace(start_tree->num_leaves);
+    findpath_moves_workspace(start_tree, dest_tree, workspace, &path);
+    free_findpath_workspace(workspace);
+    return path;
+}
+
+// add move leading to tree to the path given as data
+static int push_move(Tree* tree, long position, unsigned int move, void* data) {
+    if (position > 0) {
+        Path* path = data;
+        path_push(path, PATH_MOVE_RANK(move), PATH_MOVE_TYPE(move));
+    }
+    return 0;
+}
+
+// FINDPATH writing moves into path, using workspace instead of allocating
+// memory (path only grows if it is too short)
+int findpath_moves_workspace(Tree* start_tree,
+                             Tree* dest_tree,
+                             Findpath_Workspace* workspace,
+                             Path* path) {
+    path->length = 0;
+    path->num_length_moves = 0;
+    if (start_tree->num_leaves == dest_tree->num_leaves &&
+        start_tree->num_leaves <= workspace->max_leaves) {
+        fill_reference_tree(workspace->reference, dest_tree);
+        if (workspace->reference->ranked == FALSE ||
+            is_ranked(start_tree) == FALSE) {
+            // DCT: RNNI moves and runs of length moves
+            Tree* current_tree = workspace_copy(workspace, start_tree,
+                                                dest_tree->num_leaves);
+            dct_findpath(current_tree, workspace->reference, LONG_MAX,
+                         workspace, path);
+            return EXIT_SUCCESS;
+        }
+        if (workspace->compact != NULL) {
+            compact_findpath(start_tree, workspace->reference, LONG_MAX,
+                             workspace->compact, path);
+            return EXIT_SUCCESS;
+        }
+    }
+    if (findpath_visit_workspace(start_tree, dest_tree, workspace, push_move,
+                                 path) == -1) {
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+// FINDPATH calling visit for every tree on the path, so that the path can be
+// streamed without saving it. Returns the number of moves done, -1 on error
+long findpath_visit(Tree* start_tree,
+                    Tree* dest_tree,
+                    Findpath_Visitor visit,
+                    void* data) {
+    Findpath_Workspace* workspace =
+        new_findpath_workspace(start_tree->num_leaves);
+    long num_moves =
+        findpath_visit_workspace(start_tree, dest_tree, workspace, visit, data);
+    free_findpath_workspace(workspace);
+    return num_moves;
+}
+
+// findpath_visit using workspace instead of allocating memory; the tree given
+// to visit is workspace->tree
+long findpath_visit_workspace(Tree* start_tree,
+                              Tree* dest_tree,
+                              Findpath_Workspace* workspace,
+                              Findpath_Visitor visit,
+                              void* data) {
+    long num_leaves = start_tree->num_leaves;
+    long num_nodes = 2 * num_leaves - 1;
+    PHASE_START(copy_start);
+    Tree* current_tree =
+        workspace_copy(workspace, start_tree, dest_tree->num_leaves);
+    PHASE_END(copy_ns, copy_start);
+    if (current_tree == NULL) {
+        return -1;
+    }
+    long position = 0;  // number of moves done
+    if (visit(current_tree, position, 0, data) != 0) {
+        return position;
+    }
+    long current_mrca;  // rank of the mrca that needs to be moved down
+    // loop through internal nodes, construct cluster of node at position i in
+    // iteration i
+    for (long i = num_leaves; i < num_nodes; i++) {
+        PHASE_START(mrca_start);
+        current_mrca =
+            track_mrca(current_tree, dest_tree->node_array[i].children[0],
+                       dest_tree->node_array[i].children[1], workspace);
+        PHASE_END(mrca_ns, mrca_start);
+        // decreases current_mrca until it becomes i (the time of visit is
+        // included in moves_ns)
+        PHASE_START(moves_start);
+        while (current_mrca != i) {
+            int move_type =
+                decrease_tracked_mrca(current_tree, current_mrca, workspace);
+            position++;
+            if (visit(current_tree, position,
+                      PATH_MOVE(current_mrca - 1, move_type), data) != 0) {
+                PHASE_END(moves_ns, moves_start);
+                return position;
+            }
+            current_mrca--;
+        }
+        PHASE_END(moves_ns, moves_start);
+    }
+    return position;
+}
+
+// FINDPATH without saving the path -- returns only the distance
+// This implementation works for discrete coalesent trees DCT
+long rnni_distance(Tree* start_tree, Tree* dest_tree) {
+    if (dest_tree->num_leaves != start_tree->num_leaves) {
+        printf("Error. The input trees have different numbers of leaves.\n");
+        return EXIT_FAILURE;
+    }
+    Findpath_Workspace* workspace =
+        new_findpath_workspace(start_tree->num_leaves);
+    long distance = rnni_distance_workspace(start_tree, dest_tree, workspace);
+    free_findpath_workspace(workspace);
+    return distance;
+}
+
+Reference_Tree* new_reference_tree(Tree* tree) {
+    COUNT(allocations, 1);
+    Reference_Tree* reference = malloc(sizeof(Reference_Tree));
+    reference->max_leaves = tree->num_leaves;
+    reference->nodes = malloc(tree->num_leaves * sizeof(Reference_Node));
+    fill_reference_tree(reference, tree);
+    return reference;
+}
+
+void free_reference_tree(Reference_Tree* reference) {
+    free(reference->nodes);
+    free(reference);
+}
+
+// FindPath distance from start_tree to the tree given by reference, stopping
+// as soon as path_length (which only grows) exceeds bound
+long reference_distance_bounded(Tree* start_tree,
+                                Reference_Tree* reference,
+                                long bound,
+                                Findpath_Workspace* workspace) {
+    long num_leaves = reference->num_leaves;
+    long num_nodes = 2 * num_leaves - 1;
+    long path_length = 0;
+    int ranked = reference->ranked == TRUE && is_ranked(start_tree) == TRUE;
+    if (ranked && workspace->compact != NULL &&
+        start_tree->num_leaves == num_leaves &&
+        num_leaves <= workspace->max_leaves) {
+        return compact_findpath(start_tree, reference, bound,
+                                workspace->compact, NULL);
+    }
+    PHASE_START(copy_start);
+    Tree* current_tree = workspace_copy(workspace, start_tree, num_leaves);
+    PHASE_END(copy_ns, copy_start);
+    if (current_tree == NULL) {
+        return EXIT_FAILURE;
+    }
+    long current_mrca_rank;  // rank of the mrca that needs to be moved down
+    Reference_Node* dest_node;  // node of rank i in dest tree
+
+    if (ranked) {
+        // RNNI: every move decreases the rank of the current mrca by one
+        for (long i = num_leaves; i < num_nodes; i++) {
+            dest_node = &reference->nodes[i - num_leaves];
+            PHASE_START(mrca_start);
+            current_mrca_rank =
+                track_mrca(current_tree, dest_node->children[0],
+                           dest_node->children[1], workspace);
+            PHASE_END(mrca_ns, mrca_start);
+            path_length += current_mrca_rank - i;
+            if (path_length > bound) {
+                return bound + 1;
+            }
+            PHASE_START(moves_start);
+            while (current_mrca_rank != i) {
+                decrease_tracked_mrca(current_tree, current_mrca_rank,
+                                      workspace);
+                current_mrca_rank--;
+            }
+            PHASE_END(moves_ns, moves_start);
+        }
+        return path_length;
+    }
+
+    return dct_findpath(current_tree, reference, bound, workspace, NULL);
+}
+
+long reference_distance_workspace(Tree* start_tree,
+                                  Reference_Tree* reference,
+                                  Findpath_Workspace* workspace) {
+    return reference_distance_bounded(start_tree, reference, LONG_MAX,
+                                      workspace);
+}
+
+// rnni_distance using workspace instead of allocating memory
+long rnni_distance_workspace(Tree* start_tree,
+                             Tree* dest_tree,
+                             Findpath_Workspace* workspace) {
+    if (dest_tree->num_leaves > workspace->max_leaves) {
+        printf("Error. The input trees are too big for the workspace.\n");
+        return EXIT_FAILURE;
+    }
+    fill_reference_tree(workspace->reference, dest_tree);
+    return reference_distance_workspace(start_tree, workspace->reference,
+                                        workspace);
+}
+
+// rnni_distance_workspace stopping early if the distance exceeds bound
+long rnni_distance_bounded(Tree* start_tree,
+                           Tree* dest_tree,
+                           long bound,
+                           Findpath_Workspace* workspace) {
+    if (dest_tree->num_leaves > workspace->max_leaves) {
+        printf("Error. The input trees are too big for the workspace.\n");
+        return EXIT_FAILURE;
+    }
+    fill_reference_tree(workspace->reference, dest_tree);
+    return reference_distance_bounded(start_tree, workspace->reference, bound,
+                                      workspace);
+}
+
+// decrease the mrca of node1 and node2 in tree until it has rank r, one
+// tracked RNNI move at a time
+long decrease_mrca_to(Tree* tree,
+                      long node1,
+                      long node2,
+                      long r,
+                      Findpath_Workspace* workspace) {
+    long current_mrca = track_mrca(tree, node1, node2, workspace);
+    long num_moves = 0;
+    while (current_mrca > r) {
+        decrease_tracked_mrca(tree, current_mrca, workspace);
+        current_mrca--;
+        num_moves++;
+    }
+    return num_moves;
+}
+
 // returns the FINDPATH path between two given given trees as Tree_Array
 // (i) runs findpath and (ii) translates path matrix to actual trees on path
 Tree_Array findpath(Tree* start_tree, Tree* dest_tree) {
+    Tree_Array findpath_array =
+        get_empty_tree_array(0, start_tree->num_leaves);
+    fill_findpath(start_tree, dest_tree, &findpath_array);
+    return findpath_array;
+}
+
+// Fill findpath_array with all trees on the FINDPATH path from start_tree to
+// dest_tree, reusing its memory
+void fill_findpath(Tree* start_tree,
+                   Tree* dest_tree,
+                   Tree_Array* findpath_array) {
     long num_leaves = start_tree->num_leaves;
     Path fp = findpath_moves(start_tree, dest_tree);
 
-    Tree_Array findpath_array = get_empty_tree_array(fp.length + 1, num_leaves);
-    Tree* next_findpath_tree;
-
-    Tree* current_tree;
-    current_tree = new_tree_copy(start_tree);
+    reset_tree_array(findpath_array, fp.length + 1, num_leaves);
+    copy_tree(&findpath_array->trees[0], start_tree);
 
     // create actual path by doing moves starting at start_tree
-    // decoding the information in the matrix returned from fp
+    // tree i + 1 is tree i after move i
     for (long i = 0; i < fp.length; i++) {
-        next_findpath_tree = &findpath_array.trees[i];
-        copy_tree(next_findpath_tree, current_tree);
-        if (fp.moves[i][1] == 0) {
-            rank_move(current_tree, fp.moves[i][0]);
-        } else {
-            nni_move(current_tree, fp.moves[i][0], fp.moves[i][1] - 1);
-        }
+        Tree* next_findpath_tree = &findpath_array->trees[i + 1];
+        copy_tree(next_findpath_tree, &findpath_array->trees[i]);
+        path_apply(next_findpath_tree, &fp, i);
     }
-    // add last tree
-    next_findpath_tree = &findpath_array.trees[fp.length];
-    copy_tree(next_findpath_tree, current_tree);
 
-    for (int i = 0; i < fp.length + 1; i++) {
-        free(fp.moves[i]);
-    }
-    free(fp.moves);
-    free_tree(current_tree);
-    return findpath_array;
+    free_path(fp);
 }
@@ -1,24 +1,105 @@
 #ifndef RNNI_H_
 #define RNNI_H_
 
+#include "rng.h"
 #include "tree.h"
 
-/* Path: sequence of RNNI moves in matrix:
-Each row moves[i] is one move
-moves[i][0]:
-    lower rank of interval on which move is performed
-moves[i][1]:
+/* Path: sequence of moves, every move packed into one unsigned int
+moves[i] = PATH_MOVE(r, type) with
+r: lower rank of interval on which move is performed
+type:
     0 -> rank move
     1 -> nni move where children[0] moves up (becomes child of node at rank
-    path[i][0]+1)
-    2 -> nni move where children[1] moves up (becomes child of node at
-    rank path[i][0]+1)
+    r+1)
+    2 -> nni move where children[1] moves up (becomes child of node at rank
+    r+1)
+    3 -> run of length moves (DCT): r is the index of the run in length_moves
+moves is one buffer of capacity entries that grows when needed, and so is
+length_moves (length_capacity entries)
 */
+typedef struct Length_Move {
+    long rank;   // rank of the node whose time changes
+    long delta;  // change of its time, i.e. |delta| length moves
+} Length_Move;
+
 typedef struct Path {
-    long** moves;
+    unsigned int* moves;
     long length;
+    long capacity;
+    Length_Move* length_moves;
+    long num_length_moves;
+    long length_capacity;
 } Path;
 
+#define PATH_MOVE(r, type) ((unsigned int)(((r) << 2) | (type)))
+#define PATH_MOVE_RANK(move) ((long)((move) >> 2))
+#define PATH_MOVE_TYPE(move) ((int)((move)&3))
+#define PATH_LENGTH_MOVE 3
+
+// Function called for every tree on a FindPath path by findpath_visit:
+// tree is the tree after position moves, move the last move (PATH_MOVE, not
+// set for position 0). Returning anything but 0 stops the walk along the path
+typedef int (*Findpath_Visitor)(Tree* tree,
+                                long position,
+                                unsigned int move,
+                                void* data);
+
+// types of Move
+#define MOVE_RANK 0
+#define MOVE_NNI 1
+#define MOVE_SPR 2
+
+/* Move: description of one move on a ranked tree, so that neighbourhoods can
+be enumerated without copying trees
+MOVE_RANK: rank move on interval [rank, rank+1]
+MOVE_NNI: NNI move on edge [rank, rank+1] where children[child] of the node of
+    rank rank moves up
+MOVE_SPR: spr_move(tree, rank, new_sibling, child); old_sibling is set when the
+    move is done by apply_move (spr.h) and needed to undo it
+*/
+typedef struct Move {
+    int type;
+    long rank;
+    int child;
+    long new_sibling;
+    long old_sibling;
+} Move;
+
+// Function called for every neighbour of a tree by the visit_*_neighbourhood
+// functions: tree is the neighbour resulting from move (changed in place, so it
+// must not be changed by the visitor). Returning anything but 0 stops the
+// enumeration
+typedef int (*Move_Visitor)(Tree* tree, Move* move, void* data);
+
+// Tree that is the destination of many distance computations, preprocessed
+// once: children and times of all internal nodes in one array
+typedef struct Reference_Node {
+    long children[2];
+    long time;
+} Reference_Node;
+
+typedef struct Reference_Tree {
+    long num_leaves;
+    long max_leaves;       // nodes has space for trees with max_leaves leaves
+    Reference_Node* nodes;  // internal node of rank i at nodes[i - num_leaves]
+    int ranked;  // TRUE if times are ranks, so that no length moves are needed
+} Reference_Tree;
+
+// Memory FINDPATH needs for trees with up to max_leaves leaves. Reusing one
+// workspace for many distance computations avoids all allocations
+typedef struct Findpath_Workspace {
+    long max_leaves;
+    Tree* tree;  // copy of start tree that is changed into dest tree
+    // ancestors of the two nodes whose mrca is currently moved down (up to
+    // the mrca), so that every move can be done in constant time
+    long* ancestors[2];
+    long num_ancestors[2];
+    Reference_Tree* reference;  // dest tree of rnni_distance_workspace
+    // memory for FindPath on compact trees (compact.h), NULL if max_leaves is
+    // too big for them
+    void* compact;
+} Findpath_Workspace;
+
 // NNI move on edge [r,r+1] moving children[0] of r up to be child of r+1
 int nni_move(Tree* tree, long r, int child_moves_up);
 // rank move swapping ranks of nodes r and r+1
@@ -31,18 +112,115 @@ int move_up(Tree* tree, long lowest_moving_node, long k);
 Tree_Array rnni_neighbourhood(Tree* tree);
 // returns all trees resulting from rank moves on tree
 Tree_Array rank_neighbourhood(Tree* tree);
-// returns one neighbour drawn uniformly from one-neighbourhood
-void uniform_neighbour(Tree* input_tree);
+// same as rnni_neighbourhood/rank_neighbourhood, but writing into the arena
+// neighbour_array (see reset_tree_array), so that its memory can be reused
+// between calls
+void fill_rnni_neighbourhood(Tree* tree, Tree_Array* neighbour_array);
+void fill_rank_neighbourhood(Tree* tree, Tree_Array* neighbour_array);
+// fill moves (space for 2 * (num_leaves - 1) moves) with all RNNI moves on
+// tree, in the same order as rnni_neighbourhood; returns number of moves
+long rnni_moves(Tree* tree, Move* moves);
+// call visit for every RNNI neighbour of tree, which is created by doing the
+// move on tree and undone afterwards; returns number of neighbours visited
+long visit_rnni_neighbourhood(Tree* tree, Move_Visitor visit, void* data);
+// changes tree into a neighbour drawn uniformly from its RNNI neighbourhood
+// (random numbers from rand())
+int uniform_neighbour(Tree* input_tree);
+// same as uniform_neighbour, with random numbers from rng; the move done is
+// saved in move (if move != NULL)
+int uniform_neighbour_rng(Tree* tree, Rng* rng, Move* move);
 
 // performs (unique) RNNI move on tree that decreases the rank of the most
 // recent common ancestor of node1 and node2 by one
 int decrease_mrca(Tree* tree, long node1, long node2);
 
+Findpath_Workspace* new_findpath_workspace(long max_leaves);
+void free_findpath_workspace(Findpath_Workspace* workspace);
+
+// empty Path with space for capacity moves
+Path get_empty_path(long capacity);
+void free_path(Path path);
+// add move to the end of path
+void path_push(Path* path, long r, int type);
+// add run of length moves changing the time of the node of rank r by delta
+void path_push_length(Path* path, long r, long delta);
+// do move i of path on tree (a run of length moves in O(1))
+int path_apply(Tree* tree, Path* path, long i);
+// undo move i of path on tree, which is the tree after move i
+int path_undo(Tree* tree, Path* path, long i);
+// number of moves on path, counting every length move of a run
+long path_distance(Path* path);
+// do all moves of path on tree, in order
+int path_replay(Tree* tree, Path* path);
+// returns path in reverse direction (needs to be freed). NNI moves refer to
+// child positions, so the inverse can only be replayed on the tree the path
+// ends in, not on a copy with different children order
+Path path_inverse(Path* path);
+
 // computes a Path encoding all moves done on the FindPath path from start_tree
-// to dest_tree
+// to dest_tree. For DCTs (times are not ranks), the length moves on one node
+// between two RNNI moves are one run, so the length of the path only depends
+// on the number of RNNI moves and not on the time scale (use path_distance for
+// the distance)
 Path findpath_moves(Tree* start_tree, Tree* dest_tree);
 long rnni_distance(Tree* start_tree, Tree* dest_tree);
+// same as findpath_moves and rnni_distance, but without any allocation:
+// workspace is used as working memory and moves are written to path (created
+// by get_empty_path, only grows if it is too short)
+int findpath_moves_workspace(Tree* start_tree,
+                             Tree* dest_tree,
+                             Findpath_Workspace* workspace,
+                             Path* path);
+long rnni_distance_workspace(Tree* start_tree,
+                             Tree* dest_tree,
+                             Findpath_Workspace* workspace);
+// preprocess tree to be the destination tree of many distance computations
+Reference_Tree* new_reference_tree(Tree* tree);
+void free_reference_tree(Reference_Tree* reference);
+// make reference the reference tree of tree without allocating memory
+// (tree can't have more than reference->max_leaves leaves)
+void fill_reference_tree(Reference_Tree* reference, Tree* tree);
+// rnni_distance_workspace(start_tree, tree) for the tree that reference was
+// made from
+long reference_distance_workspace(Tree* start_tree,
+                                  Reference_Tree* reference,
+                                  Findpath_Workspace* workspace);
+// same as rnni_distance_workspace/reference_distance_workspace, but FindPath
+// stops as soon as the distance is known to be bigger than bound, and bound + 1
+// is returned then (distances to trees far away from the dest tree are only
+// needed up to a threshold in nearest neighbour searches)
+long rnni_distance_bounded(Tree* start_tree,
+                           Tree* dest_tree,
+                           long bound,
+                           Findpath_Workspace* workspace);
+long reference_distance_bounded(Tree* start_tree,
+                                Reference_Tree* reference,
+                                long bound,
+                                Findpath_Workspace* workspace);
+// decrease the mrca of node1 and node2 in tree by RNNI moves until it has rank
+// r (as in an iteration of FindPath); returns number of moves
+long decrease_mrca_to(Tree* tree,
+                      long node1,
+                      long node2,
+                      long r,
+                      Findpath_Workspace* workspace);
+// FindPath calling visit for every tree on the path from start_tree to
+// dest_tree (including both) with only one tree in memory; returns number of
+// moves done. Only RNNI moves are done (times are ignored)
+long findpath_visit(Tree* start_tree,
+                    Tree* dest_tree,
+                    Findpath_Visitor visit,
+                    void* data);
+long findpath_visit_workspace(Tree* start_tree,
+                              Tree* dest_tree,
+                              Findpath_Workspace* workspace,
+                              Findpath_Visitor visit,
+                              void* data);
 // Returns all trees along FindPath path from start_tree to dest_tree
 Tree_Array findpath(Tree* start_tree, Tree* dest_tree);
+// same as findpath, but writing into the arena findpath_array
+void fill_findpath(Tree* start_tree,
+                   Tree* dest_tree,
+                   Tree_Array* findpath_array);
 
 #endif
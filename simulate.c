@@ -0,0 +1,151 @@
+/*Simulating ranked trees*/
+
+#include "simulate.h"
+
+// coalescent: merge two lineages, drawn uniformly from all current ones, into
+// the node of rank r for r = n, ..., 2n - 2
+static void simulate_coalescent(Tree* tree, long* lineages, Rng* rng) {
+    long num_leaves = tree->num_leaves;
+    long num_lineages = num_leaves;
+    for (long i = 0; i < num_leaves; i++) {
+        lineages[i] = i;
+    }
+    for (long r = num_leaves; r < 2 * num_leaves - 1; r++) {
+        // remove two random lineages (swap with last) and add node r
+        long k = rng_below(rng, num_lineages);
+        long child0 = lineages[k];
+        lineages[k] = lineages[--num_lineages];
+        k = rng_below(rng, num_lineages);
+        long child1 = lineages[k];
+        lineages[k] = r;
+        tree->node_array[r].children[0] = child0;
+        tree->node_array[r].children[1] = child1;
+        tree->node_array[child0].parent = r;
+        tree->node_array[child1].parent = r;
+    }
+}
+
+// Yule process: starting at the root, split a lineage drawn uniformly from all
+// current ones into two at rank r for r = 2n - 2, ..., n. A lineage is
+// saved as 2 * (rank of its parent) + (child index), the final lineages get
+// leaves in random order
+static void simulate_yule(Tree* tree, long* lineages, Rng* rng) {
+    long num_leaves = tree->num_leaves;
+    long num_nodes = 2 * num_leaves - 1;
+    long num_lineages = 0;
+    for (long r = num_nodes - 1; r >= num_leaves; r--) {
+        if (r < num_nodes - 1) {
+            // node r is the lower end of a random lineage
+            long k = rng_below(rng, num_lineages);
+            long parent = lineages[k] / 2;
+            tree->node_array[parent].children[lineages[k] % 2] = r;
+            tree->node_array[r].parent = parent;
+            lineages[k] = lineages[--num_lineages];
+        }
+        lineages[num_lineages++] = 2 * r;
+        lineages[num_lineages++] = 2 * r + 1;
+    }
+    // random permutation of leaves (Fisher-Yates), so leaf i ends lineage i
+    for (long i = num_leaves - 1; i > 0; i--) {
+        long k = rng_below(rng, i + 1);
+        long lineage = lineages[k];
+        lineages[k] = lineages[i];
+        lineages[i] = lineage;
+    }
+    for (long i = 0; i < num_leaves; i++) {
+        long parent = lineages[i] / 2;
+        tree->node_array[parent].children[lineages[i] % 2] = i;
+        tree->node_array[i].parent = parent;
+    }
+}
+
+// same as simulate_tree, with lineages (space for num_leaves longs) provided
+static void simulate_tree_lineages(Tree* tree,
+                                   int model,
+                                   Rng* rng,
+                                   long* lineages) {
+    long num_leaves = tree->num_leaves;
+    long num_nodes = 2 * num_leaves - 1;
+    for (long i = 0; i < num_nodes; i++) {
+        tree->node_array[i] = get_empty_node();
+        // ranked tree: time = rank
+        tree->node_array[i].time = (i < num_leaves) ? 0 : i - num_leaves + 1;
+    }
+    if (model == SIM_YULE) {
+        simulate_yule(tree, lineages, rng);
+    } else {
+        simulate_coalescent(tree, lineages, rng);
+    }
+}
+
+void simulate_tree(Tree* tree, int model, Rng* rng) {
+    long* lineages = malloc(tree->num_leaves * sizeof(long));
+    simulate_tree_lineages(tree, model, rng, lineages);
+    free(lineages);
+}
+
+// simulate trees first_tree, ..., first_tree + num_trees - 1 (numbers for
+// random number streams) into tree_array
+static void fill_simulated_trees(Tree_Array* tree_array,
+                                 long first_tree,
+                                 long num_trees,
+                                 long num_leaves,
+                                 int model,
+                                 uint64_t seed) {
+    reset_tree_array(tree_array, num_trees, num_leaves);
+#pragma omp parallel
+    {
+        long* lineages = malloc(num_leaves * sizeof(long));
+#pragma omp for schedule(static)
+        for (long i = 0; i < num_trees; i++) {
+            Rng rng = rng_stream(seed, first_tree + i);
+            simulate_tree_lineages(&tree_array->trees[i], model, &rng,
+                                   lineages);
+        }
+        free(lineages);
+    }
+}
+
+int simulate_trees(Tree_Array* tree_array,
+                   long num_trees,
+                   long num_leaves,
+                   int model,
+                   uint64_t seed) {
+    if (num_leaves < 2) {
+        printf("Error. Trees need at least two leaves.\n");
+        return EXIT_FAILURE;
+    }
+    fill_simulated_trees(tree_array, 0, num_trees, num_leaves, model, seed);
+    return EXIT_SUCCESS;
+}
+
+int simulate_tree_file(char* filename,
+                       long num_trees,
+                       long num_leaves,
+                       int model,
+                       uint64_t seed,
+                       long batch_size) {
+    if (num_leaves < 2 || batch_size < 1) {
+        printf("Error. Trees need at least two leaves and batches at least "
+               "one tree.\n");
+        return EXIT_FAILURE;
+    }
+    Tree_File_Writer* writer = begin_tree_file(filename, num_leaves, NULL);
+    if (writer == NULL) {
+        return EXIT_FAILURE;
+    }
+    Tree_Array batch = get_empty_tree_array(0, num_leaves);
+    int result = EXIT_SUCCESS;
+    for (long first = 0; first < num_trees && result == EXIT_SUCCESS;
+         first += batch_size) {
+        long size = (num_trees - first < batch_size) ? num_trees - first
+                                                     : batch_size;
+        fill_simulated_trees(&batch, first, size, num_leaves, model, seed);
+        result = append_tree_file(writer, &batch);
+    }
+    free_tree_array(batch);
+    if (end_tree_file(writer) != EXIT_SUCCESS) {
+        result = EXIT_FAILURE;
+    }
+    return result;
+}
@@ -0,0 +1,34 @@
+#ifndef SIMULATE_H_
+#define SIMULATE_H_
+
+#include "tree_file.h"
+#include "rng.h"
+
+// models for simulate_tree. Both give the uniform distribution on ranked trees
+// (as in sim_trees.py), the coalescent by merging random pairs of lineages
+// backwards in time, the Yule process by splitting random lineages forwards in
+// time
+#define SIM_COALESCENT 0
+#define SIM_YULE 1
+
+// turn tree (with tree->num_leaves leaves) into a random ranked tree, with
+// random numbers from rng
+void simulate_tree(Tree* tree, int model, Rng* rng);
+// fill tree_array (arena, see reset_tree_array) with num_trees random ranked
+// trees on num_leaves leaves; tree i is simulated with rng_stream(seed, i), so
+// that results don't depend on the number of threads (OMP_NUM_THREADS)
+int simulate_trees(Tree_Array* tree_array,
+                   long num_trees,
+                   long num_leaves,
+                   int model,
+                   uint64_t seed);
+// simulate the same trees as simulate_trees in batches of batch_size trees and
+// write them to tree file filename, so that only one batch is in memory
+int simulate_tree_file(char* filename,
+                       long num_trees,
+                       long num_leaves,
+                       int model,
+                       uint64_t seed,
+                       long batch_size);
+
+#endif
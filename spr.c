@@ -41,47 +41,49 @@ int spr_move(Tree* tree, long r, long new_sibling, int child_moving) {
 // If horizontal = FALSE, returns RSPR neighbourhood (including rank moves),
 // otherwise HSPR neighbouhood (without rank moves)
 Tree_Array all_spr_neighbourhood(Tree* tree, int horizontal) {
+    Tree_Array neighbour_array = get_empty_tree_array(0, tree->num_leaves);
+    fill_spr_neighbourhood(tree, horizontal, &neighbour_array);
+    return (neighbour_array);
+}
+
+// Fill neighbour_array with all spr neighbours of tree (see
+// all_spr_neighbourhood), reusing its memory
+void fill_spr_neighbourhood(Tree* tree,
+                            int horizontal,
+                            Tree_Array* neighbour_array) {
     long num_leaves = tree->num_leaves;
     long max_nh_size = 2 * num_leaves * (num_leaves - 1);
 
     // Initialise array of neighbours
-    Tree_Array neighbour_array = get_empty_tree_array(max_nh_size, num_leaves);
+    reset_tree_array(neighbour_array, max_nh_size, num_leaves);
     long index = 0;  // index to the currently last element in neighbour_array
 
-    // Deep copy input tree to get neighbouring trees
-    Tree* neighbour = new_tree_copy(tree);
-    Tree* next_neighbour_array;
-    next_neighbour_array = &neighbour_array.trees[index];
-
     // Loop through all possible ranks on which moves can happen ('ranks' here
     // means position in node array, where the first n entries are leaves)
+    // Every neighbour is created by copying tree to its position in
+    // neighbour_array and doing the move there
     for (long r = num_leaves; r < 2 * num_leaves - 2; r++) {
         // Check if we can do rank move:
         if (horizontal == FALSE && r < 2 * num_leaves - 2 &&
             tree->node_array[r].parent != r + 1) {
-            rank_move(neighbour, r);
-            copy_tree(next_neighbour_array, neighbour);
+            copy_tree(&neighbour_array->trees[index], tree);
+            rank_move(&neighbour_array->trees[index], r);
             index++;
-            next_neighbour_array = &neighbour_array.trees[index];
-            copy_tree(neighbour, tree);
         }
         for (long new_sibling = 0; new_sibling < r; new_sibling++) {
             if (tree->node_array[new_sibling].parent > r) {
                 // Two SPR moves, moving either of the children of the node of
                 // rank r
                 for (int child = 0; child < 2; child++) {
-                    spr_move(neighbour, r, new_sibling, child);
-                    copy_tree(next_neighbour_array, neighbour);
+                    copy_tree(&neighbour_array->trees[index], tree);
+                    spr_move(&neighbour_array->trees[index], r, new_sibling,
+                             child);
                     index++;
-                    next_neighbour_array = &neighbour_array.trees[index];
-                    copy_tree(neighbour, tree);
                 }
             }
         }
     }
-    neighbour_array.num_trees = index;
-    free(neighbour);
-    return (neighbour_array);
+    neighbour_array->num_trees = index;
 }
 
 Tree_Array rspr_neighbourhood(Tree* tree) {
@@ -91,3 +93,102 @@ Tree_Array rspr_neighbourhood(Tree* tree) {
 Tree_Array hspr_neighbourhood(Tree* tree) {
     return all_spr_neighbourhood(tree, TRUE);
 }
+
+int apply_move(Tree* tree, Move* move) {
+    if (move->type == MOVE_RANK) {
+        return rank_move(tree, move->rank);
+    } else if (move->type == MOVE_NNI) {
+        return nni_move(tree, move->rank, move->child);
+    }
+    move->old_sibling = tree->node_array[move->rank].children[1 - move->child];
+    return spr_move(tree, move->rank, move->new_sibling, move->child);
+}
+
+// RNNI moves undo themselves. An SPR move is undone by moving the pruned
+// subtree back to its old sibling, which puts all nodes back into the same
+// child positions
+int undo_move(Tree* tree, Move* move) {
+    if (move->type != MOVE_SPR) {
+        return apply_move(tree, move);
+    }
+    return spr_move(tree, move->rank, move->old_sibling, move->child);
+}
+
+// List all moves of the RSPR/HSPR neighbourhood of tree (same order as
+// fill_spr_neighbourhood)
+long spr_moves(Tree* tree, int horizontal, Move* moves) {
+    long num_leaves = tree->num_leaves;
+    long num_moves = 0;
+    for (long r = num_leaves; r < 2 * num_leaves - 2; r++) {
+        if (horizontal == FALSE && tree->node_array[r].parent != r + 1) {
+            moves[num_moves].type = MOVE_RANK;
+            moves[num_moves].rank = r;
+            moves[num_moves].child = -1;
+            moves[num_moves].new_sibling = -1;
+            moves[num_moves].old_sibling = -1;
+            num_moves++;
+        }
+        for (long new_sibling = 0; new_sibling < r; new_sibling++) {
+            if (tree->node_array[new_sibling].parent > r) {
+                for (int child = 0; child < 2; child++) {
+                    moves[num_moves].type = MOVE_SPR;
+                    moves[num_moves].rank = r;
+                    moves[num_moves].child = child;
+                    moves[num_moves].new_sibling = new_sibling;
+                    moves[num_moves].old_sibling = -1;
+                    num_moves++;
+                }
+            }
+        }
+    }
+    return num_moves;
+}
+
+// do move, call visit on the resulting tree, and undo move again. Returns the
+// return value of visit
+static int visit_move(Tree* tree, Move* move, Move_Visitor visit, void* data) {
+    apply_move(tree, move);
+    int stop = visit(tree, move, data);
+    undo_move(tree, move);
+    return stop;
+}
+
+// Visit all RSPR/HSPR neighbours of tree (same order as all_spr_neighbourhood)
+// by doing every move in place, calling visit, and undoing the move
+long visit_spr_neighbourhood(Tree* tree,
+                             int horizontal,
+                             Move_Visitor visit,
+                             void* data) {
+    long num_leaves = tree->num_leaves;
+    long num_visited = 0;
+    Move move;
+    for (long r = num_leaves; r < 2 * num_leaves - 2; r++) {
+        move.rank = r;
+        if (horizontal == FALSE && tree->node_array[r].parent != r + 1) {
+            move.type = MOVE_RANK;
+            move.child = -1;
+            move.new_sibling = -1;
+            move.old_sibling = -1;
+            num_visited++;
+            if (visit_move(tree, &move, visit, data) != 0) {
+                return num_visited;
+            }
+        }
+        move.type = MOVE_SPR;
+        for (long new_sibling = 0; new_sibling < r; new_sibling++) {
+            // tree is restored after every move, so this is the same check as
+            // in fill_spr_neighbourhood
+            if (tree->node_array[new_sibling].parent > r) {
+                move.new_sibling = new_sibling;
+                for (int child = 0; child < 2; child++) {
+                    move.child = child;
+                    num_visited++;
+                    if (visit_move(tree, &move, visit, data) != 0) {
+                        return num_visited;
+                    }
+                }
+            }
+        }
+    }
+    return num_visited;
+}
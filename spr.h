@@ -11,7 +11,28 @@ int spr_move(Tree* tree, long r, long new_sibling, int child_moving);
 // Return all spr neighbours in array; if horizontal = FALSE (0), then give RSPR
 // neighbourhood (including rank moves), otherwise HSPR (only SPR moves)
 Tree_Array all_spr_neighbourhood(Tree* tree, int horizontal);
+// same as all_spr_neighbourhood, but writing into the arena neighbour_array
+// (see reset_tree_array), so that its memory can be reused between calls
+void fill_spr_neighbourhood(Tree* tree,
+                            int horizontal,
+                            Tree_Array* neighbour_array);
 Tree_Array rspr_neighbourhood(Tree* tree);
 Tree_Array hspr_neighbourhood(Tree* tree);
 
+// do move (RNNI or SPR, see Move) on tree in place. For SPR moves,
+// move->old_sibling is set so that the move can be undone
+int apply_move(Tree* tree, Move* move);
+// undo move done by apply_move on tree
+int undo_move(Tree* tree, Move* move);
+// fill moves (space for 2 * num_leaves * (num_leaves - 1) moves) with all moves
+// of the RSPR (horizontal = FALSE) or HSPR (horizontal = TRUE) neighbourhood of
+// tree, in the same order as all_spr_neighbourhood; returns number of moves
+long spr_moves(Tree* tree, int horizontal, Move* moves);
+// call visit for every RSPR/HSPR neighbour of tree, which is created by doing
+// the move on tree and undone afterwards; returns number of neighbours visited
+long visit_spr_neighbourhood(Tree* tree,
+                             int horizontal,
+                             Move_Visitor visit,
+                             void* data);
+
 #endif
@@ -0,0 +1,391 @@
+/*Exact RSPR and HSPR distances by bidirectional breadth first search*/
+
+#include "spr_search.h"
+#include "rng.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#define SPR_KEY_BITS 4
+#define SPR_KEY_NODES_PER_WORD 16
+
+// tree with at most SPR_SEARCH_MAX_LEAVES leaves: node i (except the root)
+// has parent num_leaves + ((bits[i / 16] >> (4 * (i % 16))) & 15)
+typedef struct Spr_Key {
+    uint64_t bits[2];
+} Spr_Key;
+
+// tree found by the search and the index of the tree it was reached from
+// (-1 for the start of a search direction)
+typedef struct Spr_State {
+    Spr_Key key;
+    long predecessor;
+} Spr_State;
+
+// One direction of the search: all trees visited so far, in the order they
+// were found, and a hash table (open addressing, linear probing) of indices
+// in states. The trees found in the last level are states[level_start], ...,
+// states[num_states - 1]
+typedef struct Spr_Side {
+    Spr_State* states;
+    long num_states;
+    long capacity;
+    long* slots;  // -1 for empty slots, at most half of them are used
+    uint64_t num_slots;
+    long level_start;
+    long depth;
+} Spr_Side;
+
+// new trees of a level found by one thread, in the order of their
+// predecessors. meeting is the first of them that the other direction has
+// already visited (-1 if there is none) and other its index there
+typedef struct Spr_Candidates {
+    Spr_Side found;
+    long meeting;
+    long other;
+} Spr_Candidates;
+
+static Spr_Key encode_tree(Tree* tree) {
+    Spr_Key key = {{0, 0}};
+    long num_leaves = tree->num_leaves;
+    for (long i = 0; i < 2 * num_leaves - 2; i++) {
+        uint64_t parent = tree->node_array[i].parent - num_leaves;
+        key.bits[i / SPR_KEY_NODES_PER_WORD] |=
+            parent << (SPR_KEY_BITS * (i % SPR_KEY_NODES_PER_WORD));
+    }
+    return key;
+}
+
+// set tree (with num_leaves leaves) to the tree encoded by key
+static void decode_tree(Spr_Key key, Tree* tree) {
+    long num_leaves = tree->num_leaves;
+    long num_nodes = 2 * num_leaves - 1;
+    for (long i = 0; i < num_nodes; i++) {
+        tree->node_array[i].parent = -1;
+        tree->node_array[i].children[0] = -1;
+        tree->node_array[i].children[1] = -1;
+        tree->node_array[i].time = (i < num_leaves) ? 0 : i - num_leaves + 1;
+    }
+    for (long i = 0; i < num_nodes - 1; i++) {
+        long parent = num_leaves +
+                      (long)((key.bits[i / SPR_KEY_NODES_PER_WORD] >>
+                              (SPR_KEY_BITS * (i % SPR_KEY_NODES_PER_WORD))) &
+                             ((1 << SPR_KEY_BITS) - 1));
+        tree->node_array[i].parent = parent;
+        int child = (tree->node_array[parent].children[0] == -1) ? 0 : 1;
+        tree->node_array[parent].children[child] = i;
+    }
+}
+
+static uint64_t key_hash(Spr_Key key) {
+    return rng_mix(key.bits[0] ^ rng_mix(key.bits[1] + RNG_GAMMA));
+}
+
+static int same_key(Spr_Key key1, Spr_Key key2) {
+    return key1.bits[0] == key2.bits[0] && key1.bits[1] == key2.bits[1];
+}
+
+static Spr_Side empty_spr_side() {
+    Spr_Side side;
+    side.capacity = 1024;
+    side.states = malloc(side.capacity * sizeof(Spr_State));
+    side.num_states = 0;
+    side.num_slots = 2 * side.capacity;
+    side.slots = malloc(side.num_slots * sizeof(long));
+    for (uint64_t slot = 0; slot < side.num_slots; slot++) {
+        side.slots[slot] = -1;
+    }
+    side.level_start = 0;
+    side.depth = 0;
+    return side;
+}
+
+static void free_spr_side(Spr_Side side) {
+    free(side.states);
+    free(side.slots);
+}
+
+// index of the tree with key in side, -1 if side has not visited it
+static long find_state(Spr_Side* side, Spr_Key key) {
+    uint64_t slot = key_hash(key) & (side->num_slots - 1);
+    while (side->slots[slot] != -1) {
+        if (same_key(side->states[side->slots[slot]].key, key)) {
+            return side->slots[slot];
+        }
+        slot = (slot + 1) & (side->num_slots - 1);
+    }
+    return -1;
+}
+
+// add state to side and return TRUE, unless its tree has already been
+// visited (FALSE)
+static int add_state(Spr_Side* side, Spr_State state) {
+    uint64_t slot = key_hash(state.key) & (side->num_slots - 1);
+    while (side->slots[slot] != -1) {
+        if (same_key(side->states[side->slots[slot]].key, state.key)) {
+            return FALSE;
+        }
+        slot = (slot + 1) & (side->num_slots - 1);
+    }
+    if (side->num_states == side->capacity) {
+        side->capacity *= 2;
+        side->states =
+            realloc(side->states, side->capacity * sizeof(Spr_State));
+        // rehash into twice as many slots
+        free(side->slots);
+        side->num_slots = 2 * side->capacity;
+        side->slots = malloc(side->num_slots * sizeof(long));
+        for (uint64_t i = 0; i < side->num_slots; i++) {
+            side->slots[i] = -1;
+        }
+        for (long i = 0; i < side->num_states; i++) {
+            slot = key_hash(side->states[i].key) & (side->num_slots - 1);
+            while (side->slots[slot] != -1) {
+                slot = (slot + 1) & (side->num_slots - 1);
+            }
+            side->slots[slot] = i;
+        }
+        slot = key_hash(state.key) & (side->num_slots - 1);
+        while (side->slots[slot] != -1) {
+            slot = (slot + 1) & (side->num_slots - 1);
+        }
+    }
+    side->slots[slot] = side->num_states;
+    side->states[side->num_states] = state;
+    side->num_states++;
+    return TRUE;
+}
+
+// all neighbours of the trees states[start], ..., states[end - 1] of side
+// that side has not visited yet, up to the first one that other has visited.
+// Stops after finding more than limit trees, or when a thread before this one
+// (*first_meeting: first thread that found a tree visited by other) met other
+static void expand_states(Spr_Side* side,
+                          Spr_Side* other,
+                          long start,
+                          long end,
+                          long limit,
+                          long thread,
+                          long* first_meeting,
+                          Tree* tree,
+                          int horizontal,
+                          Move* moves,
+                          Spr_Candidates* candidates) {
+    Spr_Side* found = &candidates->found;
+    for (long i = start; i < end && found->num_states <= limit; i++) {
+        long meeting_thread;
+#pragma omp atomic read
+        meeting_thread = *first_meeting;
+        if (meeting_thread < thread) {
+            return;
+        }
+        decode_tree(side->states[i].key, tree);
+        long num_moves = spr_moves(tree, horizontal, moves);
+        for (long j = 0; j < num_moves; j++) {
+            apply_move(tree, &moves[j]);
+            Spr_State state = {encode_tree(tree), i};
+            undo_move(tree, &moves[j]);
+            if (find_state(side, state.key) != -1 ||
+                add_state(found, state) == FALSE) {
+                continue;
+            }
+            long other_index = find_state(other, state.key);
+            if (other_index != -1) {
+                candidates->meeting = found->num_states - 1;
+                candidates->other = other_index;
+#pragma omp critical(spr_meeting)
+                if (thread < *first_meeting) {
+                    *first_meeting = thread;
+                }
+                return;
+            }
+        }
+    }
+}
+
+// Visit the next level of side, unless it has more than limit trees, up to the
+// first tree that other has visited. Threads get consecutive parts of the last
+// level, so that adding the trees they found in order of threads gives the
+// same states for any number of threads. Returns index in side of a tree that
+// other has already visited (with its index in other in *other_index), or -1
+// if the searches did not meet
+static long expand_level(Spr_Side* side,
+                         Spr_Side* other,
+                         long limit,
+                         long num_leaves,
+                         int horizontal,
+                         long* other_index) {
+    long start = side->level_start;
+    long end = side->num_states;
+    long num_threads = 1;
+#ifdef _OPENMP
+    num_threads = omp_get_max_threads();
+    if (num_threads > end - start) {
+        num_threads = end - start;
+    }
+#endif
+    Spr_Candidates* candidates =
+        malloc(num_threads * sizeof(Spr_Candidates));
+    long first_meeting = num_threads;
+#pragma omp parallel num_threads(num_threads)
+    {
+        long thread = 0;
+#ifdef _OPENMP
+        thread = omp_get_thread_num();
+#endif
+        Spr_Candidates* own = &candidates[thread];
+        own->found = empty_spr_side();
+        own->meeting = -1;
+        own->other = -1;
+        Tree* tree = get_empty_tree(num_leaves);
+        Move* moves =
+            malloc(2 * num_leaves * (num_leaves - 1) * sizeof(Move));
+        long length = end - start;
+        expand_states(side, other, start + thread * length / num_threads,
+                      start + (thread + 1) * length / num_threads, limit,
+                      thread, &first_meeting, tree, horizontal, moves, own);
+        free(moves);
+        free_tree(tree);
+    }
+
+    side->level_start = side->num_states;
+    side->depth++;
+    long meeting = -1;
+    for (long thread = 0; thread < num_threads; thread++) {
+        Spr_Candidates* own = &candidates[thread];
+        for (long i = 0; i < own->found.num_states && meeting == -1; i++) {
+            add_state(side, own->found.states[i]);
+            if (i == own->meeting) {
+                meeting = find_state(side, own->found.states[i].key);
+                *other_index = own->other;
+            }
+        }
+        free_spr_side(own->found);
+    }
+    free(candidates);
+    return meeting;
+}
+
+// keys of the trees on the path from the start of side to its tree index,
+// written into keys in reverse order (keys[0] is index)
+static long trace_keys(Spr_Side* side, long index, Spr_Key* keys) {
+    long length = 0;
+    while (index != -1) {
+        keys[length] = side->states[index].key;
+        index = side->states[index].predecessor;
+        length++;
+    }
+    return length;
+}
+
+// moves that change start_tree into the trees of keys[1], ..., keys[length]
+static Move* path_moves(Tree* start_tree, Spr_Key* keys, long length,
+                        int horizontal) {
+    long num_leaves = start_tree->num_leaves;
+    Move* path = malloc((length + 1) * sizeof(Move));
+    Move* moves = malloc(2 * num_leaves * (num_leaves - 1) * sizeof(Move));
+    Tree* tree = new_tree_copy(start_tree);
+    for (long i = 0; i < length; i++) {
+        long num_moves = spr_moves(tree, horizontal, moves);
+        for (long j = 0; j < num_moves; j++) {
+            apply_move(tree, &moves[j]);
+            if (same_key(encode_tree(tree), keys[i + 1])) {
+                path[i] = moves[j];
+                break;
+            }
+            undo_move(tree, &moves[j]);
+        }
+    }
+    free_tree(tree);
+    free(moves);
+    return path;
+}
+
+Spr_Path spr_shortest_path(Tree* start_tree,
+                           Tree* dest_tree,
+                           int horizontal,
+                           long max_states) {
+    Spr_Path result;
+    result.moves = NULL;
+    result.length = -1;
+    result.num_states = 0;
+    long num_leaves = start_tree->num_leaves;
+    if (dest_tree->num_leaves != num_leaves) {
+        printf("Error. The input trees have different numbers of leaves.\n");
+        return result;
+    }
+    if (num_leaves > SPR_SEARCH_MAX_LEAVES) {
+        printf("Error. Exact SPR distances are only computed for trees with "
+               "at most %d leaves.\n",
+               SPR_SEARCH_MAX_LEAVES);
+        return result;
+    }
+
+    // sides[0] searches from start_tree, sides[1] from dest_tree
+    Spr_Side sides[2] = {empty_spr_side(), empty_spr_side()};
+    Spr_State start_state = {encode_tree(start_tree), -1};
+    Spr_State dest_state = {encode_tree(dest_tree), -1};
+    add_state(&sides[0], start_state);
+    add_state(&sides[1], dest_state);
+    long meeting = -1;
+    long other_index = -1;
+    int expanded = 0;
+    if (same_key(sides[0].states[0].key, sides[1].states[0].key)) {
+        meeting = 0;
+        other_index = 0;
+    }
+    // Expanding a full level at a time guarantees that the first meeting
+    // gives a shortest path: if the two searches have not met after visiting
+    // all trees up to depth d0 and d1, the distance is at least d0 + d1 + 1
+    while (meeting == -1 &&
+           sides[0].num_states + sides[1].num_states <= max_states &&
+           sides[0].level_start < sides[0].num_states &&
+           sides[1].level_start < sides[1].num_states) {
+        long frontier0 = sides[0].num_states - sides[0].level_start;
+        long frontier1 = sides[1].num_states - sides[1].level_start;
+        expanded = (frontier1 < frontier0) ? 1 : 0;
+        long limit = max_states - sides[0].num_states - sides[1].num_states;
+        meeting = expand_level(&sides[expanded], &sides[1 - expanded], limit,
+                               num_leaves, horizontal, &other_index);
+    }
+    result.num_states = sides[0].num_states + sides[1].num_states;
+
+    // levels are only complete up to the meeting if they did not exceed
+    // max_states
+    if (meeting != -1 && result.num_states <= max_states) {
+        long start_index = (expanded == 0) ? meeting : other_index;
+        long dest_index = (expanded == 0) ? other_index : meeting;
+        result.length = sides[0].depth + sides[1].depth;
+        Spr_Key* keys = malloc((result.length + 2) * sizeof(Spr_Key));
+        // keys from start_tree to the meeting tree, then on to dest_tree
+        long length = trace_keys(&sides[0], start_index, keys);
+        for (long i = 0; i < length / 2; i++) {
+            Spr_Key key = keys[i];
+            keys[i] = keys[length - 1 - i];
+            keys[length - 1 - i] = key;
+        }
+        trace_keys(&sides[1], sides[1].states[dest_index].predecessor,
+                   &keys[length]);
+        result.moves =
+            path_moves(start_tree, keys, result.length, horizontal);
+        free(keys);
+    }
+    free_spr_side(sides[0]);
+    free_spr_side(sides[1]);
+    return result;
+}
+
+void free_spr_path(Spr_Path path) {
+    free(path.moves);
+}
+
+long spr_distance(Tree* start_tree,
+                  Tree* dest_tree,
+                  int horizontal,
+                  long max_states) {
+    Spr_Path path =
+        spr_shortest_path(start_tree, dest_tree, horizontal, max_states);
+    free_spr_path(path);
+    return path.length;
+}
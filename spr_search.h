@@ -0,0 +1,37 @@
+#ifndef SPR_SEARCH_H_
+#define SPR_SEARCH_H_
+
+#include "spr.h"
+
+// trees are encoded in 128 bits: 4 bits for the parent of each non-root node
+#define SPR_SEARCH_MAX_LEAVES 16
+
+// Shortest RSPR/HSPR path: moves (see Move) that change the start tree into
+// the dest tree when applied in order with apply_move. length is -1 if no
+// path was found within the given number of states. num_states is the number
+// of trees the search visited
+typedef struct Spr_Path {
+    Move* moves;
+    long length;
+    long num_states;
+} Spr_Path;
+
+// Exact shortest path between start_tree and dest_tree in RSPR (horizontal =
+// FALSE) or HSPR (horizontal = TRUE) space by bidirectional breadth first
+// search, expanding the smaller frontier by one level at a time. Neighbours of
+// a frontier are computed in parallel (OMP_NUM_THREADS); the path does not
+// depend on the number of threads. The search gives up when it visited more
+// than max_states trees (about 50 bytes each). Trees can have at most
+// SPR_SEARCH_MAX_LEAVES leaves
+Spr_Path spr_shortest_path(Tree* start_tree,
+                           Tree* dest_tree,
+                           int horizontal,
+                           long max_states);
+void free_spr_path(Spr_Path path);
+// length of spr_shortest_path (-1 if it was not found within max_states)
+long spr_distance(Tree* start_tree,
+                  Tree* dest_tree,
+                  int horizontal,
+                  long max_states);
+
+#endif
@@ -1,5 +1,9 @@
+import os
+import threading
+
 from tree_parser.tree_io import *
 from tree_functions import *
+from sim_trees import sim_coal
 
 
 def test_rnni_distance():
@@ -38,6 +42,610 @@ def test_dct_distance():
     else:
         return False
 
+def test_dct_path():
+    # runs of length moves: the path has as many moves for every time scale
+    # (once all times are far enough apart)
+    lengths = []
+    for factor in [1, 10, 1000]:
+        tree1 = read_newick("(((A:1,B:1):1,C:2):5,(D:5,E:5):2);",
+                            factor=factor)
+        tree2 = read_newick("((B:1,E:1):5,((A:3,D:3):2,C:5):1);",
+                            factor=factor)
+        path = findpath_moves(tree1, tree2)
+        lengths.append(path.length)
+        if path_distance(path) != rnni_distance(tree1, tree2):
+            return False
+        tree = read_newick("(((A:1,B:1):1,C:2):5,(D:5,E:5):2);",
+                           factor=factor)
+        path_replay(tree, path)
+        if not same_tree(tree, tree2):
+            return False
+        inverse = path_inverse(path)
+        path_replay(tree, inverse)
+        if not same_tree(tree, tree1):
+            return False
+        free_path(path)
+        free_path(inverse)
+    return lengths[1] == lengths[2]
+
+
+def test_path_inverse():
+    tree1 = read_newick("(((A:1,B:1):2,(C:2,D:2):1):1,E:4);")
+    tree2 = read_newick("((C:1,D:1):3,((B:2,E:2):1,A:3):1);")
+    path = findpath_moves(tree1, tree2)
+    inverse = path_inverse(path)
+    # NNI moves refer to child positions, so the inverse path needs to start
+    # at the tree the path ends in (not just the same tree with other children
+    # order)
+    tree = read_newick("(((A:1,B:1):2,(C:2,D:2):1):1,E:4);")
+    path_replay(tree, path)
+    path_replay(tree, inverse)
+    same = tree_to_cluster_string(tree) == tree_to_cluster_string(tree1)
+    free_path(path)
+    free_path(inverse)
+    return same
+
+
+def test_distance_matrix():
+    newick_strings = ["(((A:1,B:1):2,(C:2,D:2):1):1,E:4);",
+                      "((((C:1,E:1):1,B:2):1,A:3):1,D:4);",
+                      "((C:1,D:1):3,((B:2,E:2):1,A:3):1);"]
+    num_trees = len(newick_strings)
+    trees = (TREE * num_trees)()
+    for i in range(0, num_trees):
+        trees[i] = read_newick(newick_strings[i])
+    tree_array = TREE_ARRAY(trees, num_trees)
+    distances = (c_long * (num_trees * (num_trees - 1) // 2))()
+    rnni_distance_matrix(tree_array, distances)
+    lengths = (c_long * (num_trees * (num_trees - 1) // 2))()
+    findpath_length_matrix(tree_array, lengths)
+    index = 0
+    for i in range(0, num_trees):
+        for j in range(i + 1, num_trees):
+            dist = rnni_distance(trees[i], trees[j])
+            if distances[index] != dist or lengths[index] != dist:
+                return False
+            index += 1
+    # trees with different numbers of leaves
+    trees[2] = read_newick("((A:1,B:1):1,C:2);")
+    if silent(rnni_distance_matrix, tree_array, distances) == 0 or \
+            silent(findpath_length_matrix, tree_array, lengths) == 0:
+        return False
+    return True
+
+
+def test_distances_to():
+    newick_strings = ["(((A:1,B:1):2,(C:2,D:2):1):1,E:4);",
+                      "((((C:1,E:1):1,B:2):1,A:3):1,D:4);",
+                      "((C:1,D:1):3,((B:2,E:2):1,A:3):1);"]
+    num_trees = len(newick_strings)
+    trees = (TREE * num_trees)()
+    for i in range(0, num_trees):
+        trees[i] = read_newick(newick_strings[i])
+    tree_array = TREE_ARRAY(trees, num_trees)
+    reference = new_reference_tree(trees[0])
+    distances = (c_long * num_trees)()
+    rnni_distances_to(tree_array, reference, distances)
+    free_reference_tree(reference)
+    for i in range(0, num_trees):
+        if distances[i] != rnni_distance(trees[i], trees[0]):
+            return False
+    return sos(tree_array, trees[0]) == sum(distances)
+
+
+def test_random_walks():
+    tree = read_newick("(((A:1,B:1):2,(C:2,D:2):1):1,E:4);")
+    num_walks = 10
+    k = 20
+    trajectories = (c_long * (num_walks * (k + 1)))()
+    repeated = (c_long * (num_walks * (k + 1)))()
+    random_walks(tree, num_walks, k, 7, trajectories)
+    random_walks(tree, num_walks, k, 7, repeated)
+    for i in range(0, num_walks):
+        walk = trajectories[i * (k + 1):(i + 1) * (k + 1)]
+        if walk[0] != 0 or walk[1] != 1:
+            return False
+        # every step changes the distance by at most one
+        for j in range(1, k + 1):
+            if abs(walk[j] - walk[j - 1]) > 1:
+                return False
+    # same seed -> same walks
+    return list(trajectories) == list(repeated)
+
+
+def test_simulate_trees():
+    trees = sim_coal(10, 20, seed=3)
+    repeated = sim_coal(10, 20, seed=3)
+    correct = trees.num_trees == 20
+    for i in range(0, trees.num_trees):
+        if not same_tree(trees.trees[i], repeated.trees[i]):
+            correct = False
+        if rnni_distance(trees.trees[i], trees.trees[i]) != 0:
+            correct = False
+    free_tree_array(trees)
+    free_tree_array(repeated)
+    return correct
+
+
+def test_simulate_models():
+    correct = True
+    # tree files contain the same trees as simulate_trees, for both models
+    filename = "test_simulate.trees"
+    for model in [SIM_COALESCENT, SIM_YULE]:
+        trees = get_empty_tree_array(0, 7)
+        simulate_trees(trees, 50, 7, model, 6)
+        simulate_tree_file(filename.encode(), 50, 7, model, 6, 8)
+        tree_file = open_tree_file(filename.encode())
+        if tree_file.contents.tree_array.num_trees != 50:
+            correct = False
+        for i in range(trees.num_trees):
+            if not same_tree(tree_file_get(tree_file, i), trees.trees[i]):
+                correct = False
+        close_tree_file(tree_file)
+        free_tree_array(trees)
+    os.remove(filename)
+    # all 18 ranked trees on 4 leaves appear
+    trees = get_empty_tree_array(0, 4)
+    simulate_trees(trees, 2000, 4, SIM_YULE, 7)
+    shapes = set(tree_to_cluster_string(trees.trees[i])
+                 for i in range(trees.num_trees))
+    if len(shapes) != 18:
+        correct = False
+    free_tree_array(trees)
+    return correct
+
+
+def test_vp_tree():
+    trees = sim_coal(6, 200, seed=4)
+    query = sim_coal(6, 1, seed=5)
+    vp_tree = new_vp_tree(trees, 1)
+    # neighbours found by linear scan, ordered by distance and index
+    scan = sorted((rnni_distance(trees.trees[i], query.trees[0]), i)
+                  for i in range(trees.num_trees))
+    nearest = vp_tree_nearest(vp_tree, query.trees[0], 5)
+    within = vp_tree_within(vp_tree, query.trees[0], 3)
+    correct = [(nearest.distances[i], nearest.trees[i])
+               for i in range(nearest.num_neighbours)] == scan[:5]
+    if ([(within.distances[i], within.trees[i])
+         for i in range(within.num_neighbours)] !=
+            [pair for pair in scan if pair[0] <= 3]):
+        correct = False
+    free_neighbours(nearest)
+    free_neighbours(within)
+    free_vp_tree(vp_tree)
+    free_tree_array(trees)
+    free_tree_array(query)
+    return correct
+
+
+def test_unique_trees():
+    # 4 leaves: only 18 different ranked trees
+    trees = sim_coal(4, 100, seed=6)
+    unique = unique_trees(trees)
+    distinct = unique.tree_array
+    correct = sum(unique.counts[i] for i in range(distinct.num_trees)) == 100
+    for j in range(trees.num_trees):
+        tree = distinct.trees[unique.classes[j]]
+        if not same_tree(tree, trees.trees[j]):
+            correct = False
+        if tree_hash(tree) != tree_hash(trees.trees[j]):
+            correct = False
+    # distinct trees in order of first occurrence
+    first = [unique.classes[j] for j in range(trees.num_trees)]
+    if sorted(set(first)) != list(range(distinct.num_trees)):
+        correct = False
+    if [first.index(i) for i in range(distinct.num_trees)] != sorted(
+            first.index(i) for i in range(distinct.num_trees)):
+        correct = False
+    for i in range(distinct.num_trees):
+        for j in range(i):
+            if same_tree(distinct.trees[i], distinct.trees[j]):
+                correct = False
+    free_unique_trees(unique)
+    free_tree_array(trees)
+    # DCTs with the same ranked tree but different times are different
+    dcts = (TREE * 3)()
+    dcts[0] = read_newick("(((A:1,B:1):2,(C:2,D:2):1):1,E:4);", 10)
+    dcts[1] = read_newick("(((A:1,B:1):3,(C:2,D:2):2):1,E:5);", 10)
+    dcts[2] = read_newick("(((A:1,B:1):2,(C:2,D:2):1):1,E:4);", 10)
+    if not same_tree(dcts[0], dcts[1]):
+        correct = False
+    unique = unique_trees(TREE_ARRAY(dcts, 3))
+    if unique.tree_array.num_trees != 2 or \
+            [unique.classes[j] for j in range(3)] != [0, 1, 0] or \
+            [unique.counts[i] for i in range(2)] != [2, 1]:
+        correct = False
+    free_unique_trees(unique)
+    return correct
+
+
+def test_views():
+    trees = sim_coal(6, 20, seed=8)
+    view = tree_array_view(trees)
+    correct = view.shape == (20, 11, 4)
+    for i in range(trees.num_trees):
+        for j in range(11):
+            node = trees.trees[i].node_array[j]
+            if view[i, j, 0] != node.parent or view[i, j, 3] != node.time:
+                correct = False
+    # views share memory with the trees
+    nodes = node_view(trees.trees[2])
+    time = nodes[0, 3]
+    nodes[0, 3] = 7
+    if trees.trees[2].node_array[0].time != 7 or view[2, 0, 3] != 7:
+        correct = False
+    nodes[0, 3] = time
+    # batch calls, also from several Python threads at once
+    matrix = distance_matrix(trees)
+    if matrix[0] != rnni_distance(trees.trees[0], trees.trees[1]):
+        correct = False
+    results = [None] * 4
+
+    def run(i):
+        results[i] = distances_to(trees, trees.trees[i]).tolist()
+    threads = [threading.Thread(target=run, args=(i,)) for i in range(4)]
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+    for i in range(4):
+        if results[i] != [rnni_distance(trees.trees[j], trees.trees[i])
+                          for j in range(trees.num_trees)]:
+            correct = False
+    # failed C calls raise errors instead of returning unset distances
+    small = sim_coal(4, 1, seed=3)
+    first = trees.trees[0]
+    trees.trees[0] = small.trees[0]
+    for function, args in [(distance_matrix, (trees,)),
+                           (distances_to, (trees, first))]:
+        try:
+            silent(function, *args)
+            correct = False
+        except ValueError:
+            pass
+    trees.trees[0] = first
+    free_tree_array(small)
+    free_tree_array(trees)
+    return correct
+
+
+def test_cluster_diff():
+    newick_strings = ["(((A:1,B:1):2,(C:2,D:2):1):1,E:4);",
+                      "((((C:1,E:1):1,B:2):1,A:3):1,D:4);",
+                      "((C:1,D:1):3,((B:2,E:2):1,A:3):1);"]
+    num_trees = len(newick_strings)
+    trees = (TREE * num_trees)()
+    for i in range(0, num_trees):
+        trees[i] = read_newick(newick_strings[i])
+    tree_array = TREE_ARRAY(trees, num_trees)
+    diffs = (c_long * (num_trees * (num_trees - 1) // 2))()
+    sum_symmetric_cluster_diff_matrix(tree_array, diffs)
+    # clusters {1,2}, {3,4}, {1,2,3,4} vs {3,5}, {2,3,5}, {1,2,3,5}
+    if symmetric_cluster_diff(trees[0], trees[1], 6) != 3:
+        return False
+    if sum_symmetric_cluster_diff(trees[0], trees[1]) != 9:
+        return False
+    index = 0
+    for i in range(0, num_trees):
+        for j in range(i + 1, num_trees):
+            if diffs[index] != sum_symmetric_cluster_diff(trees[i], trees[j]):
+                return False
+            index += 1
+    return True
+
+
+def test_counters():
+    tree1 = read_newick("(((A:1,B:1):2,(C:2,D:2):1):1,E:4);")
+    tree2 = read_newick("((((C:1,E:1):1,B:2):1,A:3):1,D:4);")
+    reset_counters()
+    dist = rnni_distance(tree1, tree2)
+    counters = get_counters()
+    if not counters_enabled():
+        # compiled out: all counters stay 0
+        return counters.decrease_mrca == 0 and counters.allocations == 0
+    # every move of FindPath on ranked trees decreases an mrca
+    if counters.decrease_mrca != dist or counters.length_moves != 0:
+        return False
+    reset_counters()
+    return get_counters().decrease_mrca == 0
+
+
+def test_compact_kernels():
+    # trees with 8 bit (20 leaves) and 16 bit (200 leaves) compact kernels
+    correct = True
+    for num_leaves in [20, 200]:
+        trees = sim_coal(num_leaves, 2, seed=5)
+        dist = rnni_distance(trees.trees[0], trees.trees[1])
+        path = findpath_moves(trees.trees[0], trees.trees[1])
+        if path.length != dist:
+            correct = False
+        path_replay(trees.trees[0], path)
+        if not same_tree(trees.trees[0], trees.trees[1]):
+            correct = False
+        free_path(path)
+        free_tree_array(trees)
+    return correct
+
+
+def test_findpath_cursor():
+    tree1 = read_newick("(((A:1,B:1):2,(C:2,D:2):1):1,E:4);")
+    tree2 = read_newick("((C:1,D:1):3,((B:2,E:2):1,A:3):1);")
+    fp = findpath(tree1, tree2)
+    cursor = new_findpath_cursor(tree1, tree2)
+    correct = True
+    # seek forwards and backwards, next and prev must match findpath trees
+    for k in [2, 3, 0, 1]:
+        tree = cursor_seek(cursor, k)
+        if not same_tree(tree, fp.trees[k]):
+            correct = False
+    if not same_tree(cursor_next(cursor), fp.trees[2]):
+        correct = False
+    if not same_tree(cursor_prev(cursor), fp.trees[1]):
+        correct = False
+    cursor_seek(cursor, 3)
+    if cursor_next(cursor):
+        correct = False
+    free_findpath_cursor(cursor)
+    return correct
+
+
+def test_visit_neighbourhood():
+    tree = read_newick("(((A:1,B:1):2,(C:2,D:2):1):1,E:4);")
+    neighbours = rspr_neighbourhood(tree)
+    visited = []
+
+    def visit(neighbour, move, data):
+        visited.append(tree_to_cluster_string(neighbour.contents))
+        return 0
+
+    num_visited = visit_spr_neighbourhood(tree, 0, MOVE_VISITOR(visit), None)
+    correct = num_visited == neighbours.num_trees
+    for i in range(0, min(num_visited, neighbours.num_trees)):
+        if visited[i] != tree_to_cluster_string(neighbours.trees[i]):
+            correct = False
+    # tree is unchanged after visiting all neighbours
+    if tree_to_cluster_string(tree) != "[{1,2}:1,{3,4}:2,{1,2,3,4}:3,{1,2,3,4,5}:4]":
+        correct = False
+    free_tree_array(neighbours)
+    return correct
+
+
+def test_centroid_search():
+    newick_strings = ["(((A:1,B:1):2,(C:2,D:2):1):1,E:4);",
+                      "((((C:1,E:1):1,B:2):1,A:3):1,D:4);",
+                      "((C:1,D:1):3,((B:2,E:2):1,A:3):1);"]
+    num_trees = len(newick_strings)
+    trees = (TREE * num_trees)()
+    for i in range(0, num_trees):
+        trees[i] = read_newick(newick_strings[i])
+    tree_array = TREE_ARRAY(trees, num_trees)
+    correct = True
+    for strategy in [CENTROID_GREEDY, CENTROID_FIRST_IMPROVEMENT]:
+        result = centroid_search(tree_array, trees[1], strategy, 2, 1)
+        if sos(tree_array, result.tree) != result.score:
+            correct = False
+        if result.trace[0] != sos(tree_array, trees[1]):
+            correct = False
+        # result is a local minimum
+        neighbours = rnni_neighbourhood(result.tree)
+        for i in range(0, neighbours.num_trees):
+            if sos(tree_array, neighbours.trees[i]) < result.score:
+                correct = False
+        free_tree_array(neighbours)
+        free_centroid_result(result)
+    return correct
+
+
+def test_centroid_first_improvement():
+    # every step moves to the first neighbour (in the order of rnni_moves)
+    # with lower sos, for any number of threads
+    trees = sim_coal(8, 10, seed=14)
+    start = sim_coal(8, 2, seed=15)
+    copy_tree(start.trees[1], start.trees[0])
+    moves = (MOVE * 14)()
+    tree = start.trees[1]
+    score = sos(trees, tree)
+    expected = [score]
+    while True:
+        num_moves = rnni_moves(tree, moves)
+        for i in range(num_moves):
+            apply_move(tree, moves[i])
+            new_score = sos(trees, tree)
+            if new_score < score:
+                break
+            undo_move(tree, moves[i])
+        else:
+            break
+        score = new_score
+        expected.append(score)
+    correct = True
+    for num_threads in [1, 3, 8]:
+        lib.omp_set_num_threads(num_threads)
+        result = centroid_search(trees, start.trees[0],
+                                 CENTROID_FIRST_IMPROVEMENT, 0, 1)
+        trace = [result.trace[i] for i in range(result.trace_length)]
+        if trace != expected or result.score != expected[-1]:
+            correct = False
+        free_centroid_result(result)
+    lib.omp_set_num_threads(os.cpu_count())
+    free_tree_array(start)
+    free_tree_array(trees)
+    return correct
+
+
+def test_spr_distance():
+    # breadth first search over neighbourhoods for trees with 5 leaves
+    trees = sim_coal(5, 6, seed=9)
+    correct = True
+    for horizontal in [0, 1]:
+        distance = {tree_hash(trees.trees[0]): 0}
+        frontier = [trees.trees[0]]
+        arrays = []
+        while len(frontier) > 0:
+            next_frontier = []
+            for tree in frontier:
+                neighbours = all_spr_neighbourhood(tree, horizontal)
+                arrays.append(neighbours)
+                for i in range(neighbours.num_trees):
+                    key = tree_hash(neighbours.trees[i])
+                    if key not in distance:
+                        distance[key] = distance[tree_hash(tree)] + 1
+                        next_frontier.append(neighbours.trees[i])
+            frontier = next_frontier
+        for j in range(trees.num_trees):
+            path = spr_shortest_path(trees.trees[0], trees.trees[j],
+                                     horizontal, 100000)
+            if path.length != distance[tree_hash(trees.trees[j])]:
+                correct = False
+            # the moves of the path lead to the destination tree
+            tree = get_empty_tree(5)
+            copy_tree(tree, trees.trees[0])
+            for k in range(path.length):
+                apply_move(tree, path.moves[k])
+            if not same_tree(tree, trees.trees[j]):
+                correct = False
+            free_tree(tree)
+            free_spr_path(path)
+        # too few states
+        if spr_distance(trees.trees[0], trees.trees[1], horizontal, 1) != -1:
+            correct = False
+        for neighbours in arrays:
+            free_tree_array(neighbours)
+    free_tree_array(trees)
+    return correct
+
+
+def test_distance_tracker():
+    trees = sim_coal(8, 3, seed=10)
+    references = TREE_ARRAY(pointer(trees.trees[1]), 2)
+    tracker = new_distance_tracker(trees.trees[0], references, 2)
+    correct = True
+    moves = (MOVE * 14)()
+    for step in range(200):
+        path = tracker.contents.paths[0]
+        position = tracker.contents.positions[0]
+        if step % 3 == 0 and 0 <= position < path.length:
+            # next move on path to reference 0
+            move = MOVE()
+            move.type = 0 if path.moves[position] & 3 == 0 else 1
+            move.rank = path.moves[position] >> 2
+            move.child = (path.moves[position] & 3) - 1
+        else:
+            num_moves = rnni_moves(tracker.contents.tree, moves)
+            move = moves[(7 * step) % num_moves]
+        tracker_apply(tracker, move)
+        for i in range(2):
+            distance = rnni_distance(tracker.contents.tree,
+                                     references.trees[i])
+            if not (tracker.contents.lower[i] <= distance
+                    <= tracker.contents.upper[i]):
+                correct = False
+            if tracker.contents.upper[i] - tracker.contents.lower[i] > 2:
+                correct = False
+            if tracker_distance(tracker, i) != distance:
+                correct = False
+    free_distance_tracker(tracker)
+    # moves off the path without asking for distances: bounds get wider until
+    # they are more than max_slack apart, and only then is FindPath run
+    max_slack = 4
+    reference = TREE_ARRAY(pointer(trees.trees[1]), 1)
+    tracker = new_distance_tracker(trees.trees[0], reference, max_slack)
+    num_recomputes = tracker.contents.num_recomputes
+    for step in range(100):
+        path = tracker.contents.paths[0]
+        position = tracker.contents.positions[0]
+        num_moves = rnni_moves(tracker.contents.tree, moves)
+        for k in range(num_moves):
+            move = moves[(step + k) % num_moves]
+            packed = (move.rank << 2) | (0 if move.type == 0
+                                         else move.child + 1)
+            if not (0 <= position < path.length and
+                    path.moves[position] == packed):
+                break
+        slack = (tracker.contents.upper[0] + 1 -
+                 max(tracker.contents.lower[0] - 1, 0))
+        tracker_apply(tracker, move)
+        recomputed = tracker.contents.num_recomputes > num_recomputes
+        num_recomputes = tracker.contents.num_recomputes
+        if recomputed != (slack > max_slack):
+            correct = False
+        distance = rnni_distance(tracker.contents.tree, reference.trees[0])
+        if not (tracker.contents.lower[0] <= distance
+                <= tracker.contents.upper[0]):
+            correct = False
+    if num_recomputes < 10:
+        correct = False
+    free_distance_tracker(tracker)
+    free_tree_array(trees)
+    return correct
+
+
+def test_distances_batch():
+    # full and partial batches of pairs on 40 leaves, pairs on 70 leaves and
+    # DCTs for the scalar fallback
+    small = sim_coal(40, 20, seed=12)
+    big = sim_coal(70, 2, seed=13)
+    dct = read_newick("(((A:1,B:1):2,(C:2,D:2):1):1,E:4);", 10)
+    dct2 = read_newick("((((C:1,E:1):1,B:2):1,A:3):1,D:4);", 10)
+    correct = not is_ranked(dct) and is_ranked(small.trees[0])
+    pairs = [(small.trees[i], small.trees[(7 * i + 3) % 20])
+             for i in range(20)]
+    pairs[5] = (big.trees[0], big.trees[1])
+    pairs[11] = (dct, dct2)
+    num_pairs = len(pairs)
+    start_trees = (POINTER(TREE) * num_pairs)()
+    dest_trees = (POINTER(TREE) * num_pairs)()
+    for k in range(num_pairs):
+        start_trees[k] = pointer(pairs[k][0])
+        dest_trees[k] = pointer(pairs[k][1])
+    distances = (c_long * num_pairs)()
+    workspace = new_batch_workspace(70)
+    rnni_distances_batch(start_trees, dest_trees, num_pairs, workspace,
+                         distances)
+    free_batch_workspace(workspace)
+    for k in range(num_pairs):
+        if distances[k] != rnni_distance(pairs[k][0], pairs[k][1]):
+            correct = False
+    free_tree_array(small)
+    free_tree_array(big)
+    return correct
+
+
+def test_distance_file():
+    trees = sim_coal(6, 300, seed=11)
+    filename = "test_distances.bin"
+    if os.path.exists(filename):
+        os.remove(filename)
+    # interrupted after one tile, then resumed
+    correct = rnni_distance_matrix_file(trees, filename.encode(), 1) == 2
+    correct = correct and rnni_distance_matrix_file(
+        trees, filename.encode(), -1) == 0
+    if list(distance_file_view(filename)) != list(distance_matrix(trees)):
+        correct = False
+    os.remove(filename)
+    free_tree_array(trees)
+    # DCTs: distances count length moves and need wider entries, and files
+    # for the same trees with other times have other fingerprints
+    headers = []
+    for factor in [100000, 1000]:
+        dcts = (TREE * 2)()
+        dcts[0] = read_newick("(((A:1,B:1):2,(C:2,D:2):1):1,E:4);", factor)
+        dcts[1] = read_newick("((C:1,D:1):3,((B:2,E:2):1,A:3):1);", factor)
+        dct_array = TREE_ARRAY(dcts, 2)
+        if rnni_distance_matrix_file(dct_array, filename.encode(), -1) != 0:
+            correct = False
+        if list(distance_file_view(filename)) != \
+                [rnni_distance(dcts[0], dcts[1])]:
+            correct = False
+        with open(filename, "rb") as f:
+            headers.append(DISTANCE_FILE_HEADER.from_buffer_copy(
+                f.read(sizeof(DISTANCE_FILE_HEADER))))
+        os.remove(filename)
+    if headers[0].fingerprint == headers[1].fingerprint:
+        correct = False
+    return correct
+
+
 if __name__ == "__main__":
     if test_rnni_distance():
         print("rnni_distance() computed correctly.")
@@ -51,3 +659,87 @@ if __name__ == "__main__":
         print("rnni_distance() for DCT trees computed correctly.")
     else:
         print("Error computing rnni_distance() for DCT trees")
+    if test_dct_path():
+        print("findpath_moves() for DCTs computed correctly.")
+    else:
+        print("Error computing findpath_moves() for DCTs")
+    if test_path_inverse():
+        print("path_inverse() computed correctly.")
+    else:
+        print("Error computing path_inverse()")
+    if test_distance_matrix():
+        print("rnni_distance_matrix() computed correctly.")
+    else:
+        print("Error computing rnni_distance_matrix()")
+    if test_distances_to():
+        print("rnni_distances_to() computed correctly.")
+    else:
+        print("Error computing rnni_distances_to()")
+    if test_random_walks():
+        print("random_walks() computed correctly.")
+    else:
+        print("Error computing random_walks()")
+    if test_simulate_trees():
+        print("simulate_trees() computed correctly.")
+    else:
+        print("Error computing simulate_trees()")
+    if test_simulate_models():
+        print("simulate_tree_file() and Yule trees computed correctly.")
+    else:
+        print("Error computing simulate_tree_file() or Yule trees")
+    if test_vp_tree():
+        print("vp_tree queries computed correctly.")
+    else:
+        print("Error computing vp_tree queries")
+    if test_unique_trees():
+        print("unique_trees() computed correctly.")
+    else:
+        print("Error computing unique_trees()")
+    if test_views():
+        print("views and batch calls computed correctly.")
+    else:
+        print("Error computing views and batch calls")
+    if test_cluster_diff():
+        print("sum_symmetric_cluster_diff() computed correctly.")
+    else:
+        print("Error computing sum_symmetric_cluster_diff()")
+    if test_counters():
+        print("counters computed correctly.")
+    else:
+        print("Error computing counters")
+    if test_compact_kernels():
+        print("compact kernels computed correctly.")
+    else:
+        print("Error computing compact kernels")
+    if test_findpath_cursor():
+        print("findpath cursor computed correctly.")
+    else:
+        print("Error computing findpath cursor")
+    if test_visit_neighbourhood():
+        print("visit_spr_neighbourhood() computed correctly.")
+    else:
+        print("Error computing visit_spr_neighbourhood()")
+    if test_centroid_search():
+        print("centroid_search() computed correctly.")
+    else:
+        print("Error computing centroid_search()")
+    if test_centroid_first_improvement():
+        print("centroid_search() with first improvement computed correctly.")
+    else:
+        print("Error computing centroid_search() with first improvement")
+    if test_spr_distance():
+        print("spr_shortest_path() computed correctly.")
+    else:
+        print("Error computing spr_shortest_path()")
+    if test_distance_tracker():
+        print("distance tracker computed correctly.")
+    else:
+        print("Error computing distance tracker")
+    if test_distances_batch():
+        print("rnni_distances_batch() computed correctly.")
+    else:
+        print("Error computing rnni_distances_batch()")
+    if test_distance_file():
+        print("rnni_distance_matrix_file() computed correctly.")
+    else:
+        print("Error computing rnni_distance_matrix_file()")
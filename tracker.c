@@ -0,0 +1,113 @@
+/*Keeping RNNI distances of a tree up to date while it changes by moves*/
+
+#include "tracker.h"
+
+// exact distance to reference i by FindPath from the current tree
+static void recompute(Distance_Tracker* tracker, long i) {
+    findpath_moves_workspace(tracker->tree, &tracker->references.trees[i],
+                             tracker->workspace, &tracker->paths[i]);
+    tracker->positions[i] = 0;
+    tracker->lower[i] = tracker->paths[i].length;
+    tracker->upper[i] = tracker->paths[i].length;
+    tracker->num_recomputes++;
+}
+
+Distance_Tracker* new_distance_tracker(Tree* tree,
+                                       Tree_Array* references,
+                                       long max_slack) {
+    long num_leaves = tree->num_leaves;
+    if (is_ranked(tree) == FALSE) {
+        printf("Error. The tracked tree needs to be ranked.\n");
+        return NULL;
+    }
+    for (long i = 0; i < references->num_trees; i++) {
+        if (references->trees[i].num_leaves != num_leaves) {
+            printf("Error. The input trees have different numbers of "
+                   "leaves.\n");
+            return NULL;
+        }
+        if (is_ranked(&references->trees[i]) == FALSE) {
+            printf("Error. The reference trees need to be ranked.\n");
+            return NULL;
+        }
+    }
+    long num_references = references->num_trees;
+    Distance_Tracker* tracker = malloc(sizeof(Distance_Tracker));
+    tracker->tree = new_tree_copy(tree);
+    tracker->references = get_empty_tree_array(num_references, num_leaves);
+    tracker->lower = malloc((num_references + 1) * sizeof(long));
+    tracker->upper = malloc((num_references + 1) * sizeof(long));
+    tracker->paths = malloc((num_references + 1) * sizeof(Path));
+    tracker->positions = malloc((num_references + 1) * sizeof(long));
+    tracker->max_slack = max_slack;
+    tracker->num_recomputes = 0;
+    tracker->workspace = new_findpath_workspace(num_leaves);
+    for (long i = 0; i < num_references; i++) {
+        copy_tree(&tracker->references.trees[i], &references->trees[i]);
+        tracker->paths[i] = get_empty_path(num_leaves);
+        recompute(tracker, i);
+    }
+    return tracker;
+}
+
+void free_distance_tracker(Distance_Tracker* tracker) {
+    for (long i = 0; i < tracker->references.num_trees; i++) {
+        free_path(tracker->paths[i]);
+    }
+    free(tracker->paths);
+    free(tracker->positions);
+    free(tracker->lower);
+    free(tracker->upper);
+    free_findpath_workspace(tracker->workspace);
+    free_tree_array(tracker->references);
+    free_tree(tracker->tree);
+    free(tracker);
+}
+
+int tracker_apply(Distance_Tracker* tracker, Move* move) {
+    if (apply_move(tracker->tree, move) != EXIT_SUCCESS) {
+        return EXIT_FAILURE;
+    }
+    long num_references = tracker->references.num_trees;
+    if (move->type == MOVE_SPR) {
+        for (long i = 0; i < num_references; i++) {
+            recompute(tracker, i);
+        }
+        return EXIT_SUCCESS;
+    }
+    // RNNI moves are saved in paths as PATH_MOVE (see path_push)
+    unsigned int path_move =
+        (move->type == MOVE_RANK) ? PATH_MOVE(move->rank, 0)
+                                  : PATH_MOVE(move->rank, move->child + 1);
+    for (long i = 0; i < num_references; i++) {
+        Path* path = &tracker->paths[i];
+        long position = tracker->positions[i];
+        if (position >= 0 && position < path->length &&
+            path->moves[position] == path_move) {
+            // one step closer to the reference along a shortest path
+            tracker->positions[i]++;
+        } else if (position > 0 && path->moves[position - 1] == path_move) {
+            // RNNI moves undo themselves: back along the path
+            tracker->positions[i]--;
+        } else {
+            tracker->positions[i] = -1;
+            tracker->lower[i] = (tracker->lower[i] > 0) ? tracker->lower[i] - 1
+                                                        : 0;
+            tracker->upper[i]++;
+            if (tracker->upper[i] - tracker->lower[i] > tracker->max_slack) {
+                recompute(tracker, i);
+            }
+            continue;
+        }
+        tracker->lower[i] = path->length - tracker->positions[i];
+        tracker->upper[i] = tracker->lower[i];
+    }
+    return EXIT_SUCCESS;
+}
+
+long tracker_distance(Distance_Tracker* tracker, long i) {
+    if (tracker->lower[i] != tracker->upper[i]) {
+        recompute(tracker, i);
+    }
+    return tracker->lower[i];
+}
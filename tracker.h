@@ -0,0 +1,42 @@
+#ifndef TRACKER_H_
+#define TRACKER_H_
+
+#include "spr.h"
+
+// RNNI distances of a tree that changes by single moves to fixed reference
+// trees (all ranked). For every reference i the distance is known to be
+// between lower[i] and upper[i]. paths[i] is a FindPath path from the tree at
+// the last recomputation to reference i; as long as the moves done on tree
+// follow this path (or go back along it), positions[i] is the number of its
+// moves that tree is away from its start and the distance is exact
+// (paths[i].length - positions[i]). positions[i] is -1 once tree left the path
+typedef struct Distance_Tracker {
+    Tree* tree;              // current tree (owned by tracker)
+    Tree_Array references;  // copies of the reference trees
+    long* lower;
+    long* upper;
+    Path* paths;
+    long* positions;
+    long max_slack;        // recompute if upper - lower is bigger than this
+    long num_recomputes;  // number of FindPath computations done so far
+    Findpath_Workspace* workspace;
+} Distance_Tracker;
+
+// tracker for tree (copied) and the trees of references (copied), with exact
+// distances computed by FindPath. NULL if the trees have different numbers of
+// leaves or are not ranked
+Distance_Tracker* new_distance_tracker(Tree* tree,
+                                       Tree_Array* references,
+                                       long max_slack);
+void free_distance_tracker(Distance_Tracker* tracker);
+// Do move (see Move) on tracker->tree and update the distances: an RNNI move
+// changes each distance by at most one, and by exactly one if it is the next
+// (or previous) move on the path to a reference, which takes O(1) per
+// reference. Distances are only recomputed if bounds get wider than max_slack,
+// or after SPR moves, which can change RNNI distances by more than one
+int tracker_apply(Distance_Tracker* tracker, Move* move);
+// exact RNNI distance of tracker->tree to reference i, recomputed with
+// FindPath if only bounds are known
+long tracker_distance(Distance_Tracker* tracker, long i);
+
+#endif
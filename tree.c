@@ -2,6 +2,8 @@
 
 #include "tree.h"
 
+#include "rng.h"
+
 // create empty node
 Node get_empty_node() {
     Node new_node;
@@ -15,6 +17,7 @@ Node get_empty_node() {
 // create empty tree on num_leaves leaves
 Tree* get_empty_tree(long num_leaves) {
     long num_nodes = 2 * num_leaves - 1;
+    COUNT(allocations, 1);
     Tree* new_tree = malloc(sizeof(Tree));
     new_tree->node_array = calloc(num_nodes, sizeof(Node));
     new_tree->num_leaves = num_leaves;
@@ -33,6 +36,7 @@ void free_tree(Tree* tree) {
 // copy source_tree to dest_tree
 void copy_tree(Tree* dest_tree, Tree* source_tree) {
     long num_nodes = 2 * source_tree->num_leaves - 1;
+    COUNT(tree_copies, 1);
     for (long i = 0; i < num_nodes; i++) {
         dest_tree->node_array[i] = source_tree->node_array[i];
     }
@@ -46,23 +50,84 @@ Tree* new_tree_copy(Tree* tree) {
     return tree_copy;
 }
 
-// create an empty Tree_Array
+// make sure that tree_array has space for num_trees trees with num_nodes nodes
+// each. If keep == TRUE, the nodes in node_slab are preserved
+static void ensure_capacity(Tree_Array* tree_array,
+                            long num_trees,
+                            long num_nodes,
+                            int keep) {
+    if (num_trees > tree_array->trees_capacity) {
+        COUNT(allocations, 1);
+        tree_array->trees =
+            realloc(tree_array->trees, num_trees * sizeof(Tree));
+        tree_array->trees_capacity = num_trees;
+    }
+    if (num_trees * num_nodes > tree_array->slab_capacity) {
+        COUNT(allocations, 1);
+        if (keep == TRUE) {
+            tree_array->node_slab =
+                realloc(tree_array->node_slab,
+                        num_trees * num_nodes * sizeof(Node));
+        } else {
+            free(tree_array->node_slab);
+            tree_array->node_slab =
+                malloc(num_trees * num_nodes * sizeof(Node));
+        }
+        tree_array->slab_capacity = num_trees * num_nodes;
+    }
+}
+
+// create an empty Tree_Array, with all node_arrays in one allocation
 Tree_Array get_empty_tree_array(long num_trees, long num_leaves) {
     Tree_Array tree_array;
-    tree_array.num_trees = num_trees;
-    tree_array.trees = calloc(num_trees, sizeof(Tree));
-    for (long i = 0; i < num_trees; i++) {
-        tree_array.trees[i].num_leaves = num_leaves;
-        tree_array.trees[i].node_array =
-            calloc(2 * num_leaves - 1, sizeof(Node));
+    tree_array.trees = NULL;
+    tree_array.num_trees = 0;
+    tree_array.node_slab = NULL;
+    tree_array.slab_capacity = 0;
+    tree_array.trees_capacity = 0;
+    reset_tree_array(&tree_array, num_trees, num_leaves);
+    if (num_trees > 0) {
+        memset(tree_array.node_slab, 0,
+               num_trees * (2 * num_leaves - 1) * sizeof(Node));
     }
     return tree_array;
 }
 
+// reuse memory of tree_array for num_trees trees on num_leaves leaves
+// (nodes are not initialised)
+void reset_tree_array(Tree_Array* tree_array, long num_trees, long num_leaves) {
+    long num_nodes = 2 * num_leaves - 1;
+    ensure_capacity(tree_array, num_trees, num_nodes, FALSE);
+    tree_array->num_trees = num_trees;
+    for (long i = 0; i < num_trees; i++) {
+        tree_array->trees[i].num_leaves = num_leaves;
+        tree_array->trees[i].node_array =
+            &tree_array->node_slab[i * num_nodes];
+    }
+}
+
+// make room for num_trees trees on num_leaves leaves, keeping trees in
+// tree_array. node_arrays of trees might move!
+void reserve_tree_array(Tree_Array* tree_array,
+                        long num_trees,
+                        long num_leaves) {
+    long num_nodes = 2 * num_leaves - 1;
+    ensure_capacity(tree_array, num_trees, num_nodes, TRUE);
+    for (long i = 0; i < num_trees; i++) {
+        tree_array->trees[i].num_leaves = num_leaves;
+        tree_array->trees[i].node_array =
+            &tree_array->node_slab[i * num_nodes];
+    }
+}
+
 // free memory
 void free_tree_array(Tree_Array tree_array) {
-    for (long i = 0; i < tree_array.num_trees; i++) {
-        free(tree_array.trees[i].node_array);
+    if (tree_array.node_slab != NULL) {
+        free(tree_array.node_slab);
+    } else {
+        for (long i = 0; i < tree_array.num_trees; i++) {
+            free(tree_array.trees[i].node_array);
+        }
     }
     free(tree_array.trees);
 }
@@ -104,6 +169,29 @@ int same_tree(Tree* tree1, Tree* tree2) {
     return TRUE;
 }
 
+// sum of hashes of (node, parent) pairs -- the terms don't depend on each
+// other, so that they can be computed in parallel
+uint64_t tree_hash(Tree* tree) {
+    long num_nodes = 2 * tree->num_leaves - 1;
+    uint64_t hash = rng_mix(num_nodes);
+    for (long i = 0; i < num_nodes; i++) {
+        hash += rng_mix((uint64_t)i * RNG_GAMMA ^
+                        (uint64_t)tree->node_array[i].parent);
+    }
+    return hash;
+}
+
+// TRUE if the times of all internal nodes of tree are their ranks
+int is_ranked(Tree* tree) {
+    long num_leaves = tree->num_leaves;
+    for (long i = num_leaves; i < 2 * num_leaves - 1; i++) {
+        if (tree->node_array[i].time != i - num_leaves + 1) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
 // find rank (position in node_array) of most recent common ancestor of nodes
 // node1 and node2 in tree
 long mrca(Tree* tree, long node1, long node2) {
@@ -112,6 +200,7 @@ long mrca(Tree* tree, long node1, long node2) {
     // loop through ancestors (bottom-up) of the two nodes until ancestor of
     // both is found
     while (rank1 != rank2) {
+        COUNT(mrca_steps, 1);
         if (rank1 < rank2) {
             rank1 = tree->node_array[rank1].parent;
             if (rank1 == -1) {
@@ -128,3 +217,78 @@ long mrca(Tree* tree, long node1, long node2) {
     }
     return rank1;
 }
+
+// number of bits needed for x > 0, minus one (floor of log_2)
+static long floor_log2(long x) {
+    return 63 - __builtin_clzl(x);
+}
+
+// create index for mrca queries on tree
+Mrca_Index* new_mrca_index(Tree* tree) {
+    long num_nodes = 2 * tree->num_leaves - 1;
+    Mrca_Index* index = malloc(sizeof(Mrca_Index));
+    index->num_nodes = num_nodes;
+    index->num_levels = floor_log2(num_nodes) + 1;
+    index->position = malloc(num_nodes * sizeof(long));
+    index->max_rank = malloc(index->num_levels * num_nodes * sizeof(long));
+    update_mrca_index(index, tree);
+    return index;
+}
+
+// fill index for tree: in-order listing of nodes, then sparse table
+void update_mrca_index(Mrca_Index* index, Tree* tree) {
+    long num_nodes = index->num_nodes;
+    long* in_order = index->max_rank;  // level 0 of the table
+    // iterative in-order traversal: the stack (stored in position, which is
+    // filled afterwards) contains nodes whose left subtree is being listed
+    long* stack = index->position;
+    long stack_size = 0;
+    long num_listed = 0;
+    long node = num_nodes - 1;  // root
+    while (node != -1 || stack_size > 0) {
+        while (node != -1) {
+            stack[stack_size++] = node;
+            node = tree->node_array[node].children[0];
+        }
+        node = stack[--stack_size];
+        in_order[num_listed++] = node;
+        node = tree->node_array[node].children[1];
+    }
+    for (long p = 0; p < num_nodes; p++) {
+        index->position[in_order[p]] = p;
+    }
+    // level k: maximum of two overlapping ranges of level k-1
+    for (long k = 1; k < index->num_levels; k++) {
+        long* level = &index->max_rank[k * num_nodes];
+        long* prev_level = &index->max_rank[(k - 1) * num_nodes];
+        long half = 1L << (k - 1);
+        for (long p = 0; p + 2 * half <= num_nodes; p++) {
+            level[p] = (prev_level[p] > prev_level[p + half])
+                           ? prev_level[p]
+                           : prev_level[p + half];
+        }
+    }
+}
+
+void free_mrca_index(Mrca_Index* index) {
+    free(index->position);
+    free(index->max_rank);
+    free(index);
+}
+
+// rank of mrca of node1 and node2: highest rank between their positions in
+// in-order
+long mrca_index_query(Mrca_Index* index, long node1, long node2) {
+    long first = index->position[node1];
+    long last = index->position[node2];
+    if (first > last) {
+        long tmp = first;
+        first = last;
+        last = tmp;
+    }
+    long k = floor_log2(last - first + 1);
+    long* level = &index->max_rank[k * index->num_nodes];
+    long left = level[first];
+    long right = level[last - (1L << k) + 1];
+    return (left > right) ? left : right;
+}
@@ -1,12 +1,16 @@
 #ifndef TREE_H_
 #define TREE_H_
 
+#include <limits.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 
+#include "counters.h"
+
 #define EXIT_SUCCESS 0
 #define EXIT_FAILURE 1
 
@@ -31,9 +35,17 @@ typedef struct Tree {
 } Tree;
 
 // array of num_trees trees
+// Tree_Arrays created by get_empty_tree_array are arenas: the node_arrays of
+// all trees are stored in one allocation node_slab, tree i at position
+// i * (2 * num_leaves - 1). node_slab is NULL if trees own their node_arrays.
+// slab_capacity: number of Nodes that fit into node_slab
+// trees_capacity: number of Trees that fit into trees
 typedef struct Tree_Array {
     Tree* trees;
     long num_trees;
+    Node* node_slab;
+    long slab_capacity;
+    long trees_capacity;
 } Tree_Array;
 
 Node get_empty_node();
@@ -46,6 +58,15 @@ void copy_tree(Tree* dest_tree, Tree* source_tree);
 Tree* new_tree_copy(Tree* tree);
 
 Tree_Array get_empty_tree_array(long num_trees, long num_leaves);
+// make tree_array (created by get_empty_tree_array) an array of num_trees
+// trees on num_leaves leaves, reusing its memory if it is big enough. Trees
+// that were in tree_array before are lost
+void reset_tree_array(Tree_Array* tree_array, long num_trees, long num_leaves);
+// make room for num_trees trees on num_leaves leaves in tree_array (created by
+// get_empty_tree_array), keeping the trees that are already in it
+void reserve_tree_array(Tree_Array* tree_array,
+                        long num_trees,
+                        long num_leaves);
 void free_tree_array(Tree_Array tree_array);
 
 // print parent, children, and time for all nodes in tree
@@ -55,9 +76,38 @@ void print_tree(Tree* tree);
 int same_topology(Tree* tree1, Tree* tree2);
 // check if trees are identical
 int same_tree(Tree* tree1, Tree* tree2);
+// 64 bit hash of the parents of all nodes of tree: identical trees (same_tree)
+// have the same hash, and different trees have different hashes with high
+// probability
+uint64_t tree_hash(Tree* tree);
+// TRUE if the times of all internal nodes of tree are their ranks (ranked
+// tree, not a DCT)
+int is_ranked(Tree* tree);
 
 // return rank of most recent common ancestor (lowest/least common ancestor) of
 // nodes node1 and node2 in input_tree
 long mrca(Tree* tree, long node1, long node2);
 
+// Index for mrca queries in constant time on a tree that does not change.
+// In an in-order listing of the nodes of a ranked tree (left subtree, node,
+// right subtree), the mrca of two nodes is the node with highest rank between
+// them, which is looked up in a sparse table of range maxima:
+// max_rank[k * num_nodes + p] is the highest rank among the 2^k nodes starting
+// at position p
+typedef struct Mrca_Index {
+    long num_nodes;
+    long num_levels;
+    long* position;  // position of each node in in-order
+    long* max_rank;
+} Mrca_Index;
+
+// O(n log n) preprocessing
+Mrca_Index* new_mrca_index(Tree* tree);
+// rebuild index for (changed) tree with the same number of leaves, without
+// allocating memory
+void update_mrca_index(Mrca_Index* index, Tree* tree);
+void free_mrca_index(Mrca_Index* index);
+// rank of mrca of node1 and node2 in the tree index was built for
+long mrca_index_query(Mrca_Index* index, long node1, long node2);
+
 #endif
@@ -0,0 +1,250 @@
+/*Binary files of tree collections that can be memory mapped*/
+
+#include "tree_file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "tree_io.h"
+
+// node records start at a multiple of this (bytes)
+#define TREE_FILE_ALIGNMENT 64
+
+// write header and taxon table; the header is completed by end_tree_file
+Tree_File_Writer* begin_tree_file(char* filename,
+                                  long num_leaves,
+                                  char** taxa) {
+    FILE* f = fopen(filename, "wb");
+    if (f == NULL) {
+        printf("Error. Can't open file %s.\n", filename);
+        return NULL;
+    }
+    Tree_File_Writer* writer = malloc(sizeof(Tree_File_Writer));
+    writer->file = f;
+    Tree_File_Header* header = &writer->header;
+    memset(header, 0, sizeof(Tree_File_Header));
+    memcpy(header->magic, TREE_FILE_MAGIC, 8);
+    header->version = TREE_FILE_VERSION;
+    header->node_size = sizeof(Node);
+    header->byte_order = 1;
+    header->num_leaves = num_leaves;
+    header->num_trees = 0;
+    header->taxa_offset = sizeof(Tree_File_Header);
+    int written = fwrite(header, sizeof(Tree_File_Header), 1, f) == 1;
+
+    // taxon table
+    long position = header->taxa_offset;
+    char name[32];
+    for (long i = 0; i < num_leaves && written; i++) {
+        char* taxon = name;
+        if (taxa == NULL) {
+            snprintf(name, sizeof(name), "%ld", i + 1);
+        } else {
+            taxon = taxa[i];
+        }
+        long length = strlen(taxon) + 1;
+        written = fwrite(taxon, 1, length, f) == (size_t)length;
+        position += length;
+    }
+    // padding, so that node records are aligned
+    while (position % TREE_FILE_ALIGNMENT != 0 && written) {
+        written = fputc(0, f) != EOF;
+        position++;
+    }
+    if (!written) {
+        printf("Error. Couldn't write tree file %s.\n", filename);
+        fclose(f);
+        free(writer);
+        return NULL;
+    }
+    header->nodes_offset = position;
+    return writer;
+}
+
+int append_tree_file(Tree_File_Writer* writer, Tree_Array* tree_array) {
+    long num_leaves = writer->header.num_leaves;
+    long num_nodes = 2 * num_leaves - 1;
+    for (long i = 0; i < tree_array->num_trees; i++) {
+        if (tree_array->trees[i].num_leaves != num_leaves) {
+            printf(
+                "Error. All trees in a tree file need to have the same "
+                "number of leaves.\n");
+            return EXIT_FAILURE;
+        }
+    }
+    for (long i = 0; i < tree_array->num_trees; i++) {
+        if (fwrite(tree_array->trees[i].node_array, sizeof(Node), num_nodes,
+                   writer->file) != (size_t)num_nodes) {
+            printf("Error. Couldn't write tree file.\n");
+            // the header only counts the trees written completely
+            writer->header.num_trees += i;
+            return EXIT_FAILURE;
+        }
+    }
+    writer->header.num_trees += tree_array->num_trees;
+    return EXIT_SUCCESS;
+}
+
+// now that we know the number of trees, complete header
+int end_tree_file(Tree_File_Writer* writer) {
+    int result = EXIT_SUCCESS;
+    if (fseek(writer->file, 0, SEEK_SET) != 0 ||
+        fwrite(&writer->header, sizeof(Tree_File_Header), 1, writer->file) !=
+            1) {
+        printf("Error. Couldn't write tree file.\n");
+        result = EXIT_FAILURE;
+    }
+    if (fclose(writer->file) != 0 && result == EXIT_SUCCESS) {
+        printf("Error. Couldn't write tree file.\n");
+        result = EXIT_FAILURE;
+    }
+    free(writer);
+    return result;
+}
+
+// write all trees in tree_array with taxon names taxa to file
+int write_tree_file(char* filename, Tree_Array* tree_array, char** taxa) {
+    if (tree_array->num_trees == 0) {
+        printf("Error. Can't write empty Tree_Array to file.\n");
+        return EXIT_FAILURE;
+    }
+    Tree_File_Writer* writer =
+        begin_tree_file(filename, tree_array->trees[0].num_leaves, taxa);
+    if (writer == NULL) {
+        return EXIT_FAILURE;
+    }
+    int result = append_tree_file(writer, tree_array);
+    if (end_tree_file(writer) != EXIT_SUCCESS) {
+        result = EXIT_FAILURE;
+    }
+    return result;
+}
+
+// read nexus file and save trees as tree file
+int nexus_to_tree_file(char* nexus_filename, char* filename, double factor) {
+    char** taxa = NULL;
+    Tree_Array tree_array = parse_nexus(nexus_filename, factor, &taxa);
+    if (tree_array.num_trees == 0) {
+        return EXIT_FAILURE;
+    }
+    long num_leaves = tree_array.trees[0].num_leaves;
+    int result = write_tree_file(filename, &tree_array, taxa);
+    free_taxa(taxa, num_leaves);
+    free_tree_array(tree_array);
+    return result;
+}
+
+// memory map tree file
+Tree_File* open_tree_file(char* filename) {
+    int fd = open(filename, O_RDONLY);
+    if (fd == -1) {
+        printf("Error. Can't open file %s.\n", filename);
+        return NULL;
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 ||
+        file_stat.st_size < (long)sizeof(Tree_File_Header)) {
+        printf("Error. %s is not a tree file.\n", filename);
+        close(fd);
+        return NULL;
+    }
+    // private mapping: pages are shared with other processes until a tree is
+    // modified
+    void* map = mmap(NULL, file_stat.st_size, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        printf("Error. Can't map file %s into memory.\n", filename);
+        return NULL;
+    }
+
+    Tree_File_Header* header = map;
+    if (memcmp(header->magic, TREE_FILE_MAGIC, 8) != 0 ||
+        header->version != TREE_FILE_VERSION) {
+        printf("Error. %s is not a tree file.\n", filename);
+        munmap(map, file_stat.st_size);
+        return NULL;
+    }
+    if (header->node_size != sizeof(Node) || header->byte_order != 1) {
+        printf("Error. %s was written on an incompatible machine.\n",
+               filename);
+        munmap(map, file_stat.st_size);
+        return NULL;
+    }
+    // header values are not trusted: all offsets and sizes need to be inside
+    // the file before anything is read from there
+    long size = file_stat.st_size;
+    if (header->num_leaves < 2 || header->num_trees < 0 ||
+        header->taxa_offset < (long)sizeof(Tree_File_Header) ||
+        header->nodes_offset < header->taxa_offset ||
+        header->nodes_offset > size ||
+        header->nodes_offset % TREE_FILE_ALIGNMENT != 0 ||
+        header->num_leaves > size) {
+        printf("Error. %s is not a tree file.\n", filename);
+        munmap(map, size);
+        return NULL;
+    }
+    // every taxon takes at least one byte, so num_nodes can't overflow
+    long num_nodes = 2 * header->num_leaves - 1;
+    // division, so that large values of num_trees can't overflow
+    if (header->num_trees >
+        (size - header->nodes_offset) / (num_nodes * (long)sizeof(Node))) {
+        printf("Error. Tree file %s is truncated.\n", filename);
+        munmap(map, size);
+        return NULL;
+    }
+
+    // every taxon needs to end before the node records
+    char** taxa = malloc(header->num_leaves * sizeof(char*));
+    char* taxon = (char*)map + header->taxa_offset;
+    char* taxa_end = (char*)map + header->nodes_offset;
+    for (long i = 0; i < header->num_leaves; i++) {
+        char* end = memchr(taxon, '\0', taxa_end - taxon);
+        if (end == NULL) {
+            printf("Error. Taxon table of tree file %s is corrupted.\n",
+                   filename);
+            free(taxa);
+            munmap(map, size);
+            return NULL;
+        }
+        taxa[i] = taxon;
+        taxon = end + 1;
+    }
+
+    Tree_File* tree_file = malloc(sizeof(Tree_File));
+    tree_file->map = map;
+    tree_file->map_size = file_stat.st_size;
+    tree_file->num_leaves = header->num_leaves;
+    tree_file->taxa = taxa;
+
+    // the mapped node records are the node slab of tree_array
+    Node* nodes = (Node*)((char*)map + header->nodes_offset);
+    tree_file->tree_array.num_trees = header->num_trees;
+    tree_file->tree_array.trees = malloc(header->num_trees * sizeof(Tree));
+    tree_file->tree_array.node_slab = nodes;
+    tree_file->tree_array.slab_capacity = header->num_trees * num_nodes;
+    tree_file->tree_array.trees_capacity = header->num_trees;
+    for (long i = 0; i < header->num_trees; i++) {
+        tree_file->tree_array.trees[i].num_leaves = header->num_leaves;
+        tree_file->tree_array.trees[i].node_array = &nodes[i * num_nodes];
+    }
+    return tree_file;
+}
+
+// tree at position i in tree file
+Tree* tree_file_get(Tree_File* tree_file, long i) {
+    if (i < 0 || i >= tree_file->tree_array.num_trees) {
+        printf("Error. There is no tree %ld in tree file.\n", i);
+        return NULL;
+    }
+    return &tree_file->tree_array.trees[i];
+}
+
+void close_tree_file(Tree_File* tree_file) {
+    munmap(tree_file->map, tree_file->map_size);
+    free(tree_file->taxa);
+    free(tree_file->tree_array.trees);
+    free(tree_file);
+}
@@ -0,0 +1,68 @@
+#ifndef TREE_FILE_H_
+#define TREE_FILE_H_
+
+#include "tree.h"
+
+/* Binary file format for collections of trees on the same leaves:
+Header (Tree_File_Header), followed by the taxon table (num_leaves
+null-terminated strings, taxon of leaf i at position i), followed by the node
+records of all trees, starting at nodes_offset: tree i occupies the 2 *
+num_leaves - 1 Nodes starting at nodes_offset + i * (2 * num_leaves - 1) *
+sizeof(Node).
+Node records are stored exactly as in memory, so files need to be read on
+machines with the same sizeof(Node) and byte order (both are checked).
+*/
+#define TREE_FILE_MAGIC "TREEOCLK"
+#define TREE_FILE_VERSION 1
+
+typedef struct Tree_File_Header {
+    char magic[8];
+    long version;
+    long node_size;  // sizeof(Node) of the writing machine
+    long byte_order;  // 1 in the byte order of the writing machine
+    long num_leaves;
+    long num_trees;
+    long taxa_offset;   // position of taxon table in file (bytes)
+    long nodes_offset;  // position of first node record in file (bytes)
+} Tree_File_Header;
+
+// Tree file mapped into memory: trees in tree_array point directly into the
+// mapping (copy-on-write, so trees can be modified without changing the file),
+// which is the node_slab of tree_array. tree_array must not be freed with
+// free_tree_array or grown beyond its capacity (reserve_tree_array) -- use
+// close_tree_file
+typedef struct Tree_File {
+    Tree_Array tree_array;
+    char** taxa;
+    long num_leaves;
+    void* map;
+    long map_size;
+} Tree_File;
+
+// Tree file that is being written, so that trees can be appended in batches
+typedef struct Tree_File_Writer {
+    FILE* file;
+    Tree_File_Header header;
+} Tree_File_Writer;
+
+// start writing tree file for trees on num_leaves leaves with taxon names taxa
+// (leaves are named 1, ..., n if taxa == NULL); NULL if file can't be opened
+Tree_File_Writer* begin_tree_file(char* filename, long num_leaves, char** taxa);
+// append all trees in tree_array to tree file
+int append_tree_file(Tree_File_Writer* writer, Tree_Array* tree_array);
+// complete header and close file
+int end_tree_file(Tree_File_Writer* writer);
+
+// write all trees in tree_array with taxon names taxa to file; if taxa == NULL,
+// leaves are named 1, ..., n
+int write_tree_file(char* filename, Tree_Array* tree_array, char** taxa);
+// read nexus file (see parse_nexus) and save trees as tree file
+int nexus_to_tree_file(char* nexus_filename, char* filename, double factor);
+
+// memory map tree file; returns NULL if the file can't be opened
+Tree_File* open_tree_file(char* filename);
+// tree at position i in tree file (no copy)
+Tree* tree_file_get(Tree_File* tree_file, long i);
+void close_tree_file(Tree_File* tree_file);
+
+#endif
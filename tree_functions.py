@@ -1,6 +1,8 @@
 __author__ = 'Lena Collienne, Jordan Kettles'
 
+import mmap
 import os
+import sys
 from ctypes import *
 
 lib = CDLL(f'{os.path.dirname(os.path.realpath(__file__))}/tree.so')
@@ -24,13 +26,70 @@ class TREE(Structure):
 
 
 class TREE_ARRAY(Structure):
-    _fields_ = [('trees', POINTER(TREE)), ('num_trees', c_long)]
+    _fields_ = [('trees', POINTER(TREE)), ('num_trees', c_long),
+                ('node_slab', POINTER(NODE)), ('slab_capacity', c_long),
+                ('trees_capacity', c_long)]
 
     def __init_(self, trees, num_trees):
         self.trees = trees
         self.num_trees = num_trees
 
 
+class LENGTH_MOVE(Structure):
+    _fields_ = [('rank', c_long), ('delta', c_long)]
+
+
+class PATH(Structure):
+    _fields_ = [('moves', POINTER(c_uint)), ('length', c_long),
+                ('capacity', c_long), ('length_moves', POINTER(LENGTH_MOVE)),
+                ('num_length_moves', c_long), ('length_capacity', c_long)]
+
+
+class REFERENCE_NODE(Structure):
+    _fields_ = [('children', c_long * 2), ('time', c_long)]
+
+
+class REFERENCE_TREE(Structure):
+    _fields_ = [('num_leaves', c_long), ('max_leaves', c_long),
+                ('nodes', POINTER(REFERENCE_NODE)), ('ranked', c_int)]
+
+
+class MOVE(Structure):
+    _fields_ = [('type', c_int), ('rank', c_long), ('child', c_int),
+                ('new_sibling', c_long), ('old_sibling', c_long)]
+
+
+MOVE_VISITOR = CFUNCTYPE(c_int, POINTER(TREE), POINTER(MOVE), c_void_p)
+
+
+# from counters.h
+
+
+class COUNTERS(Structure):
+    _fields_ = [('decrease_mrca', c_long), ('length_moves', c_long),
+                ('mrca_steps', c_long), ('tree_copies', c_long),
+                ('allocations', c_long), ('copy_ns', c_long),
+                ('mrca_ns', c_long), ('moves_ns', c_long)]
+
+
+counters_enabled = lib.counters_enabled
+counters_enabled.argtypes = []
+counters_enabled.restype = c_int
+
+get_counters = lib.get_counters
+get_counters.argtypes = []
+get_counters.restype = COUNTERS
+
+get_all_counters = lib.get_all_counters
+get_all_counters.argtypes = []
+get_all_counters.restype = COUNTERS
+
+reset_counters = lib.reset_counters
+reset_counters.argtypes = []
+
+reset_all_counters = lib.reset_all_counters
+reset_all_counters.argtypes = []
+
 # from tree.h
 
 get_empty_node = lib.get_empty_node
@@ -51,6 +110,12 @@ get_empty_tree_array = lib.get_empty_tree_array
 get_empty_tree_array.argtypes = [c_long, c_long]
 get_empty_tree_array.restype = TREE_ARRAY
 
+reset_tree_array = lib.reset_tree_array
+reset_tree_array.argtypes = [POINTER(TREE_ARRAY), c_long, c_long]
+
+reserve_tree_array = lib.reserve_tree_array
+reserve_tree_array.argtypes = [POINTER(TREE_ARRAY), c_long, c_long]
+
 free_tree_array = lib.free_tree_array
 free_tree_array.argtypes = [TREE_ARRAY]
 
@@ -66,6 +131,14 @@ same_tree = lib.same_tree
 same_tree.argtypes = [POINTER(TREE), POINTER(TREE)]
 same_tree.restype = c_int
 
+tree_hash = lib.tree_hash
+tree_hash.argtypes = [POINTER(TREE)]
+tree_hash.restype = c_uint64
+
+is_ranked = lib.is_ranked
+is_ranked.argtypes = [POINTER(TREE)]
+is_ranked.restype = c_int
+
 mrca = lib.mrca
 mrca.argtypes = [POINTER(TREE), c_long, c_long]
 mrca.restype = c_long
@@ -100,6 +173,71 @@ findpath = lib.findpath
 findpath.argtypes = [POINTER(TREE), POINTER(TREE)]
 findpath.restype = TREE_ARRAY
 
+findpath_moves = lib.findpath_moves
+findpath_moves.argtypes = [POINTER(TREE), POINTER(TREE)]
+findpath_moves.restype = PATH
+
+free_path = lib.free_path
+free_path.argtypes = [PATH]
+
+path_replay = lib.path_replay
+path_replay.argtypes = [POINTER(TREE), POINTER(PATH)]
+path_replay.restype = c_int
+
+path_inverse = lib.path_inverse
+path_inverse.argtypes = [POINTER(PATH)]
+path_inverse.restype = PATH
+
+path_distance = lib.path_distance
+path_distance.argtypes = [POINTER(PATH)]
+path_distance.restype = c_long
+
+new_reference_tree = lib.new_reference_tree
+new_reference_tree.argtypes = [POINTER(TREE)]
+new_reference_tree.restype = POINTER(REFERENCE_TREE)
+
+free_reference_tree = lib.free_reference_tree
+free_reference_tree.argtypes = [POINTER(REFERENCE_TREE)]
+
+rnni_moves = lib.rnni_moves
+rnni_moves.argtypes = [POINTER(TREE), POINTER(MOVE)]
+rnni_moves.restype = c_long
+
+visit_rnni_neighbourhood = lib.visit_rnni_neighbourhood
+visit_rnni_neighbourhood.argtypes = [POINTER(TREE), MOVE_VISITOR, c_void_p]
+visit_rnni_neighbourhood.restype = c_long
+
+# from geodesic.h
+
+
+class FINDPATH_CURSOR(Structure):
+    _fields_ = [('path', PATH), ('tree', POINTER(TREE)),
+                ('position', c_long)]
+
+
+new_findpath_cursor = lib.new_findpath_cursor
+new_findpath_cursor.argtypes = [POINTER(TREE), POINTER(TREE)]
+new_findpath_cursor.restype = POINTER(FINDPATH_CURSOR)
+
+free_findpath_cursor = lib.free_findpath_cursor
+free_findpath_cursor.argtypes = [POINTER(FINDPATH_CURSOR)]
+
+cursor_next = lib.cursor_next
+cursor_next.argtypes = [POINTER(FINDPATH_CURSOR)]
+cursor_next.restype = POINTER(TREE)
+
+cursor_prev = lib.cursor_prev
+cursor_prev.argtypes = [POINTER(FINDPATH_CURSOR)]
+cursor_prev.restype = POINTER(TREE)
+
+cursor_seek = lib.cursor_seek
+cursor_seek.argtypes = [POINTER(FINDPATH_CURSOR), c_long]
+cursor_seek.restype = POINTER(TREE)
+
+findpath_tree = lib.findpath_tree
+findpath_tree.argtypes = [POINTER(TREE), POINTER(TREE), c_long, POINTER(TREE)]
+findpath_tree.restype = c_int
+
 # from spr.h
 
 spr_move = lib.spr_move
@@ -118,12 +256,34 @@ hspr_neighbourhood = lib.hspr_neighbourhood
 hspr_neighbourhood.argtypes = [POINTER(TREE)]
 hspr_neighbourhood.restype = TREE_ARRAY
 
+apply_move = lib.apply_move
+apply_move.argtypes = [POINTER(TREE), POINTER(MOVE)]
+apply_move.restype = c_int
+
+undo_move = lib.undo_move
+undo_move.argtypes = [POINTER(TREE), POINTER(MOVE)]
+undo_move.restype = c_int
+
+spr_moves = lib.spr_moves
+spr_moves.argtypes = [POINTER(TREE), c_int, POINTER(MOVE)]
+spr_moves.restype = c_long
+
+visit_spr_neighbourhood = lib.visit_spr_neighbourhood
+visit_spr_neighbourhood.argtypes = [POINTER(TREE), c_int, MOVE_VISITOR,
+                                    c_void_p]
+visit_spr_neighbourhood.restype = c_long
+
 # from exploring_rnni.h
 
 random_walk_distance = lib.random_walk_distance
 random_walk_distance.argtypes = [POINTER(TREE), c_long]
 random_walk_distance.restype = c_long
 
+random_walks = lib.random_walks
+random_walks.argtypes = [POINTER(TREE), c_long, c_long, c_uint64,
+                         POINTER(c_long)]
+random_walks.restype = c_int
+
 first_iteration_fp = lib.first_iteration_fp
 first_iteration_fp.argtypes = [POINTER(TREE_ARRAY), c_long, c_long, c_long]
 first_iteration_fp.restype = c_int
@@ -137,9 +297,346 @@ mrca_array.argtypes = [POINTER(TREE), POINTER(TREE)]
 mrca_array.restype = POINTER(c_long)
 
 mrca_differences = lib.mrca_differences
-mrca_differences.argtypes = [POINTER(TREE), POINTER(TREE)]
+mrca_differences.argtypes = [POINTER(TREE), POINTER(TREE), c_int]
 mrca_differences.restype = c_long
 
 symmetric_cluster_diff = lib.symmetric_cluster_diff
 symmetric_cluster_diff.argtypes = [POINTER(TREE), POINTER(TREE), c_long]
-symmetric_cluster_diff.restype = c_long
\ No newline at end of file
+symmetric_cluster_diff.restype = c_long
+
+sum_symmetric_cluster_diff = lib.sum_symmetric_cluster_diff
+sum_symmetric_cluster_diff.argtypes = [POINTER(TREE), POINTER(TREE)]
+sum_symmetric_cluster_diff.restype = c_long
+
+
+class CLUSTERS(Structure):
+    _fields_ = [('num_leaves', c_long), ('num_words', c_long),
+                ('bits', POINTER(c_uint64))]
+
+
+new_clusters = lib.new_clusters
+new_clusters.argtypes = [POINTER(TREE)]
+new_clusters.restype = POINTER(CLUSTERS)
+
+free_clusters = lib.free_clusters
+free_clusters.argtypes = [POINTER(CLUSTERS)]
+
+clusters_symmetric_diff = lib.clusters_symmetric_diff
+clusters_symmetric_diff.argtypes = [POINTER(CLUSTERS), POINTER(CLUSTERS), c_long]
+clusters_symmetric_diff.restype = c_long
+
+clusters_sum_symmetric_diff = lib.clusters_sum_symmetric_diff
+clusters_sum_symmetric_diff.argtypes = [POINTER(CLUSTERS), POINTER(CLUSTERS)]
+clusters_sum_symmetric_diff.restype = c_long
+
+sum_symmetric_cluster_diff_matrix = lib.sum_symmetric_cluster_diff_matrix
+sum_symmetric_cluster_diff_matrix.argtypes = [POINTER(TREE_ARRAY),
+                                              POINTER(c_long)]
+sum_symmetric_cluster_diff_matrix.restype = c_int
+
+# from centroid.h
+
+CENTROID_GREEDY = 0
+CENTROID_FIRST_IMPROVEMENT = 1
+
+
+class CENTROID_RESULT(Structure):
+    _fields_ = [('tree', POINTER(TREE)), ('score', c_long),
+                ('trace', POINTER(c_long)), ('trace_length', c_long),
+                ('run_starts', POINTER(c_long)), ('num_runs', c_long)]
+
+
+centroid_search = lib.centroid_search
+centroid_search.argtypes = [POINTER(TREE_ARRAY), POINTER(TREE), c_int, c_long,
+                            c_uint]
+centroid_search.restype = CENTROID_RESULT
+
+free_centroid_result = lib.free_centroid_result
+free_centroid_result.argtypes = [CENTROID_RESULT]
+
+# from distances.h
+
+rnni_distance_matrix = lib.rnni_distance_matrix
+rnni_distance_matrix.argtypes = [POINTER(TREE_ARRAY), POINTER(c_long)]
+rnni_distance_matrix.restype = c_int
+
+findpath_length_matrix = lib.findpath_length_matrix
+findpath_length_matrix.argtypes = [POINTER(TREE_ARRAY), POINTER(c_long)]
+findpath_length_matrix.restype = c_int
+
+rnni_distances_to = lib.rnni_distances_to
+rnni_distances_to.argtypes = [POINTER(TREE_ARRAY), POINTER(REFERENCE_TREE),
+                              POINTER(c_long)]
+rnni_distances_to.restype = c_int
+
+
+class DISTANCE_FILE_HEADER(Structure):
+    _fields_ = [('magic', c_char * 8), ('version', c_long),
+                ('byte_order', c_long), ('num_trees', c_long),
+                ('num_leaves', c_long), ('fingerprint', c_uint64),
+                ('entry_size', c_long), ('tile_size', c_long),
+                ('num_tiles', c_long), ('tiles_offset', c_long),
+                ('entries_offset', c_long)]
+
+
+rnni_distance_matrix_file = lib.rnni_distance_matrix_file
+rnni_distance_matrix_file.argtypes = [POINTER(TREE_ARRAY), c_char_p, c_long]
+rnni_distance_matrix_file.restype = c_long
+
+# from tree_io.h
+
+parse_newick = lib.parse_newick
+parse_newick.argtypes = [c_char_p, c_double]
+parse_newick.restype = POINTER(TREE)
+
+parse_nexus = lib.parse_nexus
+parse_nexus.argtypes = [c_char_p, c_double, POINTER(POINTER(c_char_p))]
+parse_nexus.restype = TREE_ARRAY
+
+free_taxa = lib.free_taxa
+free_taxa.argtypes = [POINTER(c_char_p), c_long]
+
+# from tree_file.h
+
+
+class TREE_FILE(Structure):
+    _fields_ = [('tree_array', TREE_ARRAY), ('taxa', POINTER(c_char_p)),
+                ('num_leaves', c_long), ('map', c_void_p),
+                ('map_size', c_long)]
+
+
+write_tree_file = lib.write_tree_file
+write_tree_file.argtypes = [c_char_p, POINTER(TREE_ARRAY), POINTER(c_char_p)]
+write_tree_file.restype = c_int
+
+nexus_to_tree_file = lib.nexus_to_tree_file
+nexus_to_tree_file.argtypes = [c_char_p, c_char_p, c_double]
+nexus_to_tree_file.restype = c_int
+
+open_tree_file = lib.open_tree_file
+open_tree_file.argtypes = [c_char_p]
+open_tree_file.restype = POINTER(TREE_FILE)
+
+tree_file_get = lib.tree_file_get
+tree_file_get.argtypes = [POINTER(TREE_FILE), c_long]
+tree_file_get.restype = POINTER(TREE)
+
+close_tree_file = lib.close_tree_file
+close_tree_file.argtypes = [POINTER(TREE_FILE)]
+
+# from simulate.h
+
+SIM_COALESCENT = 0
+SIM_YULE = 1
+
+simulate_trees = lib.simulate_trees
+simulate_trees.argtypes = [POINTER(TREE_ARRAY), c_long, c_long, c_int, c_uint64]
+simulate_trees.restype = c_int
+
+simulate_tree_file = lib.simulate_tree_file
+simulate_tree_file.argtypes = [c_char_p, c_long, c_long, c_int, c_uint64,
+                               c_long]
+simulate_tree_file.restype = c_int
+
+# from vp_tree.h
+
+
+class VP_NODE(Structure):
+    _fields_ = [('vantage', c_long), ('children', c_long * 2),
+                ('min_distance', c_long * 2), ('max_distance', c_long * 2),
+                ('start', c_long), ('end', c_long)]
+
+
+class VP_TREE(Structure):
+    _fields_ = [('tree_array', POINTER(TREE_ARRAY)),
+                ('nodes', POINTER(VP_NODE)), ('num_nodes', c_long),
+                ('order', POINTER(c_long))]
+
+
+class NEIGHBOURS(Structure):
+    _fields_ = [('trees', POINTER(c_long)), ('distances', POINTER(c_long)),
+                ('num_neighbours', c_long), ('num_distances', c_long)]
+
+
+new_vp_tree = lib.new_vp_tree
+new_vp_tree.argtypes = [POINTER(TREE_ARRAY), c_uint64]
+new_vp_tree.restype = POINTER(VP_TREE)
+
+free_vp_tree = lib.free_vp_tree
+free_vp_tree.argtypes = [POINTER(VP_TREE)]
+
+vp_tree_nearest = lib.vp_tree_nearest
+vp_tree_nearest.argtypes = [POINTER(VP_TREE), POINTER(TREE), c_long]
+vp_tree_nearest.restype = NEIGHBOURS
+
+vp_tree_within = lib.vp_tree_within
+vp_tree_within.argtypes = [POINTER(VP_TREE), POINTER(TREE), c_long]
+vp_tree_within.restype = NEIGHBOURS
+
+free_neighbours = lib.free_neighbours
+free_neighbours.argtypes = [NEIGHBOURS]
+
+# from unique.h
+
+
+class UNIQUE_TREES(Structure):
+    _fields_ = [('tree_array', TREE_ARRAY), ('counts', POINTER(c_long)),
+                ('classes', POINTER(c_long))]
+
+
+unique_trees = lib.unique_trees
+unique_trees.argtypes = [POINTER(TREE_ARRAY)]
+unique_trees.restype = UNIQUE_TREES
+
+free_unique_trees = lib.free_unique_trees
+free_unique_trees.argtypes = [UNIQUE_TREES]
+
+# from spr_search.h
+
+
+class SPR_PATH(Structure):
+    _fields_ = [('moves', POINTER(MOVE)), ('length', c_long),
+                ('num_states', c_long)]
+
+
+spr_shortest_path = lib.spr_shortest_path
+spr_shortest_path.argtypes = [POINTER(TREE), POINTER(TREE), c_int, c_long]
+spr_shortest_path.restype = SPR_PATH
+
+free_spr_path = lib.free_spr_path
+free_spr_path.argtypes = [SPR_PATH]
+
+spr_distance = lib.spr_distance
+spr_distance.argtypes = [POINTER(TREE), POINTER(TREE), c_int, c_long]
+spr_distance.restype = c_long
+
+# from tracker.h
+
+
+class DISTANCE_TRACKER(Structure):
+    _fields_ = [('tree', POINTER(TREE)), ('references', TREE_ARRAY),
+                ('lower', POINTER(c_long)), ('upper', POINTER(c_long)),
+                ('paths', POINTER(PATH)), ('positions', POINTER(c_long)),
+                ('max_slack', c_long), ('num_recomputes', c_long),
+                ('workspace', c_void_p)]
+
+
+new_distance_tracker = lib.new_distance_tracker
+new_distance_tracker.argtypes = [POINTER(TREE), POINTER(TREE_ARRAY), c_long]
+new_distance_tracker.restype = POINTER(DISTANCE_TRACKER)
+
+free_distance_tracker = lib.free_distance_tracker
+free_distance_tracker.argtypes = [POINTER(DISTANCE_TRACKER)]
+
+tracker_apply = lib.tracker_apply
+tracker_apply.argtypes = [POINTER(DISTANCE_TRACKER), POINTER(MOVE)]
+tracker_apply.restype = c_int
+
+tracker_distance = lib.tracker_distance
+tracker_distance.argtypes = [POINTER(DISTANCE_TRACKER), c_long]
+tracker_distance.restype = c_long
+
+# from batch.h
+
+new_batch_workspace = lib.new_batch_workspace
+new_batch_workspace.argtypes = [c_long]
+new_batch_workspace.restype = c_void_p
+
+free_batch_workspace = lib.free_batch_workspace
+free_batch_workspace.argtypes = [c_void_p]
+
+rnni_distances_batch = lib.rnni_distances_batch
+rnni_distances_batch.argtypes = [POINTER(POINTER(TREE)),
+                                 POINTER(POINTER(TREE)), c_long, c_void_p,
+                                 POINTER(c_long)]
+rnni_distances_batch.restype = c_int
+
+
+def silent(function, *args):
+    '''call function with everything the C library prints (e.g. expected
+    error messages in tests) going to /dev/null'''
+    libc = CDLL(None)
+    sys.stdout.flush()
+    libc.fflush(None)
+    stdout = os.dup(1)
+    devnull = os.open(os.devnull, os.O_WRONLY)
+    os.dup2(devnull, 1)
+    try:
+        return function(*args)
+    finally:
+        libc.fflush(None)
+        os.dup2(stdout, 1)
+        os.close(devnull)
+        os.close(stdout)
+
+
+# Zero-copy views and batch calls
+# Views expose memory of C trees through the buffer protocol without copying,
+# e.g. numpy.asarray(node_view(tree)) is an array sharing memory with tree.
+# A view is only valid until the tree (array) it was made from is freed or
+# reset. ctypes releases the GIL during every call into tree.so, so batch calls
+# (distance matrices, distances_to, neighbourhoods, ...) from different Python
+# threads run in parallel.
+
+NODE_FIELDS = 4  # parent, children[0], children[1], time
+
+
+def _long_view(address, shape):
+    '''memoryview of c_longs at address with given shape'''
+    count = 1
+    for length in shape:
+        count *= length
+    return memoryview((c_long * count).from_address(address)).cast(
+        'B').cast('l', shape)
+
+
+def node_view(tree):
+    '''view of node_array of tree, shape (2 * num_leaves - 1, 4): columns
+    parent, children[0], children[1], time'''
+    num_nodes = 2 * tree.num_leaves - 1
+    return _long_view(addressof(tree.node_array.contents),
+                      (num_nodes, NODE_FIELDS))
+
+
+def tree_array_view(tree_array):
+    '''view of all trees of an arena tree_array (get_empty_tree_array), shape
+    (num_trees, 2 * num_leaves - 1, 4)'''
+    if not tree_array.node_slab or tree_array.num_trees == 0:
+        raise ValueError("tree_array has no trees in one node slab")
+    num_nodes = 2 * tree_array.trees[0].num_leaves - 1
+    return _long_view(addressof(tree_array.node_slab.contents),
+                      (tree_array.num_trees, num_nodes, NODE_FIELDS))
+
+
+def distance_matrix(tree_array):
+    '''view of condensed matrix of RNNI distances of all pairs of trees (one C
+    call, using all cores)'''
+    num_trees = tree_array.num_trees
+    distances = (c_long * max(num_trees * (num_trees - 1) // 2, 1))()
+    if rnni_distance_matrix(tree_array, distances) != 0:
+        raise ValueError("can't compute distances between these trees")
+    return memoryview(distances).cast('B').cast('l')[
+        :num_trees * (num_trees - 1) // 2]
+
+
+def distances_to(tree_array, tree):
+    '''view of RNNI distances from all trees in tree_array to tree (one C call,
+    using all cores)'''
+    distances = (c_long * max(tree_array.num_trees, 1))()
+    reference = new_reference_tree(tree)
+    result = rnni_distances_to(tree_array, reference, distances)
+    free_reference_tree(reference)
+    if result != 0:
+        raise ValueError("can't compute distances between these trees")
+    return memoryview(distances).cast('B').cast('l')[:tree_array.num_trees]
+
+
+def distance_file_view(filename):
+    '''read-only view of the condensed matrix in a distance file written by
+    rnni_distance_matrix_file (memory mapped, entries are only read from disk
+    when they are accessed)'''
+    with open(filename, 'rb') as f:
+        data = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+    header = DISTANCE_FILE_HEADER.from_buffer_copy(data)
+    entries = memoryview(data)[header.entries_offset:]
+    return entries.cast('H' if header.entry_size == 2 else 'I')
@@ -0,0 +1,555 @@
+/*Reading ranked trees from newick strings and nexus files*/
+
+#include "tree_io.h"
+
+#include <ctype.h>
+#include <strings.h>
+
+// leaf label as it appears in newick strings and the taxon it stands for
+// (taxon == label if there is no TRANSLATE block)
+typedef struct Label {
+    char* label;
+    char* taxon;
+} Label;
+
+// internal node (temporary index) with its height, for sorting
+typedef struct Node_Height {
+    double height;
+    long node;
+} Node_Height;
+
+// Memory needed for reading trees on num_leaves leaves -- allocated once and
+// reused for every tree of a nexus file.
+// While reading a tree, leaves get their final index in node_array and internal
+// nodes get temporary indices num_leaves, num_leaves + 1, ... in the order in
+// which they appear in the newick string, i.e. parents before children
+typedef struct Parser {
+    long num_leaves;
+    Label* labels;  // sorted by label: labels[i] is the label of leaf i
+    long* parent;
+    long* children;  // children of internal node i at 2 * (i - num_leaves)
+    long* num_children;
+    double* length;  // length of edge above node
+    double* height;  // height (time) of internal nodes
+    Node_Height* sorted;  // internal nodes sorted by increasing height
+    long* rank;           // final position of internal nodes in node_array
+    char* buffer;         // null-terminated copy of the label to look up
+    size_t buffer_size;
+} Parser;
+
+static int compare_labels(const void* a, const void* b) {
+    return strcmp(((Label*)a)->label, ((Label*)b)->label);
+}
+
+static int compare_heights(const void* a, const void* b) {
+    double height_a = ((Node_Height*)a)->height;
+    double height_b = ((Node_Height*)b)->height;
+    return (height_a > height_b) - (height_a < height_b);
+}
+
+// skip comment starting at pos ('['), returns position after closing ']'
+static char* skip_comment(char* pos) {
+    while (*pos != '\0' && *pos != ']') {
+        pos++;
+    }
+    if (*pos == ']') {
+        pos++;
+    }
+    return pos;
+}
+
+// read (possibly quoted) label starting at pos; sets start and length of
+// label and returns position after label
+static char* read_label(char* pos, char** start, size_t* length) {
+    if (*pos == '\'') {
+        pos++;
+        *start = pos;
+        while (*pos != '\0' && *pos != '\'') {
+            pos++;
+        }
+        *length = pos - *start;
+        if (*pos == '\'') {
+            pos++;
+        }
+        return pos;
+    }
+    *start = pos;
+    while (*pos != '\0' && strchr(":,();[", *pos) == NULL &&
+           !isspace((unsigned char)*pos)) {
+        pos++;
+    }
+    *length = pos - *start;
+    return pos;
+}
+
+static char* copy_label(char* start, size_t length) {
+    char* label = malloc(length + 1);
+    memcpy(label, start, length);
+    label[length] = '\0';
+    return label;
+}
+
+// create parser for trees with the given (unsorted) labels; takes ownership of
+// labels. Returns NULL if a label appears twice
+static Parser* new_parser(Label* labels, long num_leaves) {
+    qsort(labels, num_leaves, sizeof(Label), compare_labels);
+    for (long i = 1; i < num_leaves; i++) {
+        if (strcmp(labels[i - 1].label, labels[i].label) == 0) {
+            printf("Error. Leaf label %s appears more than once.\n",
+                   labels[i].label);
+            for (long j = 0; j < num_leaves; j++) {
+                free(labels[j].label);
+                free(labels[j].taxon);
+            }
+            free(labels);
+            return NULL;
+        }
+    }
+    long num_nodes = 2 * num_leaves - 1;
+    Parser* parser = malloc(sizeof(Parser));
+    parser->num_leaves = num_leaves;
+    parser->labels = labels;
+    parser->parent = malloc(num_nodes * sizeof(long));
+    parser->children = malloc(2 * num_leaves * sizeof(long));
+    parser->num_children = malloc(num_nodes * sizeof(long));
+    parser->length = malloc(num_nodes * sizeof(double));
+    parser->height = malloc(num_nodes * sizeof(double));
+    parser->sorted = malloc(num_leaves * sizeof(Node_Height));
+    parser->rank = malloc(num_nodes * sizeof(long));
+    parser->buffer_size = 64;
+    parser->buffer = malloc(parser->buffer_size);
+    return parser;
+}
+
+static void free_parser(Parser* parser) {
+    for (long i = 0; i < parser->num_leaves; i++) {
+        free(parser->labels[i].label);
+        free(parser->labels[i].taxon);
+    }
+    free(parser->labels);
+    free(parser->parent);
+    free(parser->children);
+    free(parser->num_children);
+    free(parser->length);
+    free(parser->height);
+    free(parser->sorted);
+    free(parser->rank);
+    free(parser->buffer);
+    free(parser);
+}
+
+// create parser for trees with the leaf labels of the newick string s
+static Parser* parser_from_newick(char* s) {
+    long num_labels = 0;
+    long capacity = 16;
+    Label* labels = malloc(capacity * sizeof(Label));
+    int after_close = FALSE;  // labels after ')' belong to internal nodes
+    char* pos = s;
+    while (*pos != '\0' && *pos != ';') {
+        if (*pos == '[') {
+            pos = skip_comment(pos);
+        } else if (*pos == ':') {
+            // skip edge length
+            pos++;
+            strtod(pos, &pos);
+        } else if (*pos == ')') {
+            after_close = TRUE;
+            pos++;
+        } else if (*pos == '(' || *pos == ',') {
+            after_close = FALSE;
+            pos++;
+        } else if (isspace((unsigned char)*pos)) {
+            pos++;
+        } else {
+            char* start;
+            size_t length;
+            pos = read_label(pos, &start, &length);
+            if (!after_close) {
+                if (num_labels == capacity) {
+                    capacity *= 2;
+                    labels = realloc(labels, capacity * sizeof(Label));
+                }
+                labels[num_labels].label = copy_label(start, length);
+                labels[num_labels].taxon = copy_label(start, length);
+                num_labels++;
+            }
+        }
+    }
+    if (num_labels < 2) {
+        printf("Error. Newick string needs to have at least two leaves.\n");
+        for (long i = 0; i < num_labels; i++) {
+            free(labels[i].label);
+            free(labels[i].taxon);
+        }
+        free(labels);
+        return NULL;
+    }
+    return new_parser(labels, num_labels);
+}
+
+// create parser for trees with labels given in the body of a TRANSLATE block
+// (token taxon, token taxon, ...;)
+static Parser* parser_from_translate(char* s) {
+    long num_labels = 0;
+    long capacity = 16;
+    Label* labels = malloc(capacity * sizeof(Label));
+    char* pos = s;
+    while (*pos != '\0' && *pos != ';') {
+        if (isspace((unsigned char)*pos) || *pos == ',') {
+            pos++;
+            continue;
+        }
+        char* start;
+        size_t length;
+        pos = read_label(pos, &start, &length);
+        if (length == 0) {
+            // not a valid token -- skip character
+            pos++;
+            continue;
+        }
+        char* label = copy_label(start, length);
+        while (isspace((unsigned char)*pos)) {
+            pos++;
+        }
+        pos = read_label(pos, &start, &length);
+        if (num_labels == capacity) {
+            capacity *= 2;
+            labels = realloc(labels, capacity * sizeof(Label));
+        }
+        labels[num_labels].label = label;
+        labels[num_labels].taxon = copy_label(start, length);
+        num_labels++;
+    }
+    if (num_labels < 2) {
+        printf("Error. TRANSLATE block needs to have at least two taxa.\n");
+        for (long i = 0; i < num_labels; i++) {
+            free(labels[i].label);
+            free(labels[i].taxon);
+        }
+        free(labels);
+        return NULL;
+    }
+    return new_parser(labels, num_labels);
+}
+
+// index of leaf with given label, -1 if the label is unknown
+static long leaf_index(Parser* parser, char* start, size_t length) {
+    if (length + 1 > parser->buffer_size) {
+        parser->buffer_size = 2 * (length + 1);
+        parser->buffer = realloc(parser->buffer, parser->buffer_size);
+    }
+    memcpy(parser->buffer, start, length);
+    parser->buffer[length] = '\0';
+    Label key;
+    key.label = parser->buffer;
+    Label* found = bsearch(&key, parser->labels, parser->num_leaves,
+                           sizeof(Label), compare_labels);
+    if (found == NULL) {
+        return -1;
+    }
+    return found - parser->labels;
+}
+
+// add child to internal node (temporary index) parent
+static int add_child(Parser* parser, long parent, long child) {
+    if (parent == -1) {
+        printf("Error. Newick string has nodes outside of brackets.\n");
+        return EXIT_FAILURE;
+    }
+    long i = parent - parser->num_leaves;
+    if (parser->num_children[parent] == 2) {
+        printf("Error. Tree is not binary.\n");
+        return EXIT_FAILURE;
+    }
+    parser->children[2 * i + parser->num_children[parent]] = child;
+    parser->num_children[parent]++;
+    parser->parent[child] = parent;
+    return EXIT_SUCCESS;
+}
+
+// read newick string s into tree, which needs to have num_leaves leaves
+static int read_tree(Parser* parser, char* s, double factor, Tree* tree) {
+    long num_leaves = parser->num_leaves;
+    long num_nodes = 2 * num_leaves - 1;
+    for (long i = 0; i < num_leaves; i++) {
+        parser->parent[i] = -1;
+        parser->length[i] = 0;
+    }
+
+    // first pass: relations between nodes and edge lengths
+    char* pos = s;
+    while (*pos != '\0' && *pos != '(') {
+        pos = (*pos == '[') ? skip_comment(pos) : pos + 1;
+    }
+    long current = -1;  // internal node whose children we are reading
+    long prev = -1;     // node the next edge length belongs to
+    long next_internal = num_leaves;
+    int after_close = FALSE;
+    while (*pos != '\0' && *pos != ';') {
+        if (*pos == '(') {
+            if (next_internal == num_nodes) {
+                printf("Error. Tree is not binary.\n");
+                return EXIT_FAILURE;
+            }
+            long new_node = next_internal++;
+            parser->num_children[new_node] = 0;
+            parser->length[new_node] = 0;
+            parser->parent[new_node] = -1;
+            if (current != -1 &&
+                add_child(parser, current, new_node) != EXIT_SUCCESS) {
+                return EXIT_FAILURE;
+            }
+            current = new_node;
+            prev = new_node;
+            after_close = FALSE;
+            pos++;
+        } else if (*pos == ')') {
+            if (current == -1) {
+                printf("Error. Unbalanced brackets in newick string.\n");
+                return EXIT_FAILURE;
+            }
+            prev = current;
+            current = parser->parent[current];
+            after_close = TRUE;
+            pos++;
+            if (current == -1) {
+                // root is complete -- ignore everything after it
+                break;
+            }
+        } else if (*pos == ',') {
+            after_close = FALSE;
+            pos++;
+        } else if (*pos == ':') {
+            pos++;
+            char* end;
+            double length = strtod(pos, &end);
+            if (end == pos) {
+                printf("Error. Can't read edge length in newick string.\n");
+                return EXIT_FAILURE;
+            }
+            if (prev != -1) {
+                parser->length[prev] = length;
+            }
+            pos = end;
+        } else if (*pos == '[') {
+            pos = skip_comment(pos);
+        } else if (isspace((unsigned char)*pos)) {
+            pos++;
+        } else {
+            char* start;
+            size_t length;
+            pos = read_label(pos, &start, &length);
+            if (after_close) {
+                // label of internal node -- ignore
+                continue;
+            }
+            long leaf = leaf_index(parser, start, length);
+            if (leaf == -1) {
+                printf("Error. Unknown leaf label %.*s.\n", (int)length,
+                       start);
+                return EXIT_FAILURE;
+            }
+            if (parser->parent[leaf] != -1) {
+                printf("Error. Leaf %.*s appears more than once.\n",
+                       (int)length, start);
+                return EXIT_FAILURE;
+            }
+            if (add_child(parser, current, leaf) != EXIT_SUCCESS) {
+                return EXIT_FAILURE;
+            }
+            prev = leaf;
+        }
+    }
+    if (current != -1 || next_internal != num_nodes) {
+        printf("Error. Newick string is incomplete or tree is not binary.\n");
+        return EXIT_FAILURE;
+    }
+    for (long i = 0; i < num_nodes; i++) {
+        if ((i < num_leaves && parser->parent[i] == -1) ||
+            (i >= num_leaves && parser->num_children[i] != 2)) {
+            printf("Error. Tree is not binary or has missing leaves.\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    // heights of internal nodes -- children have higher temporary indices than
+    // their parents, so we go through them backwards
+    for (long i = num_nodes - 1; i >= num_leaves; i--) {
+        long child = parser->children[2 * (i - num_leaves)];
+        parser->height[i] = parser->length[child];
+        if (child >= num_leaves) {
+            parser->height[i] += parser->height[child];
+        }
+        parser->sorted[i - num_leaves].height = parser->height[i];
+        parser->sorted[i - num_leaves].node = i;
+    }
+    // ranking of internal nodes
+    qsort(parser->sorted, num_leaves - 1, sizeof(Node_Height),
+          compare_heights);
+    for (long i = 0; i < num_leaves - 1; i++) {
+        if (i > 0 && parser->sorted[i].height == parser->sorted[i - 1].height) {
+            printf("Error. There are internal nodes with equal times.\n");
+            return EXIT_FAILURE;
+        }
+        parser->rank[parser->sorted[i].node] = num_leaves + i;
+    }
+
+    // fill node_array
+    for (long i = 0; i < num_leaves; i++) {
+        tree->node_array[i] = get_empty_node();
+        tree->node_array[i].parent = parser->rank[parser->parent[i]];
+        tree->node_array[i].time = 0;
+    }
+    // internal nodes from root to bottom, so we can make sure that no two
+    // nodes get the same time when discretising
+    long prev_time = -1;
+    for (long i = num_leaves - 2; i >= 0; i--) {
+        long node = parser->sorted[i].node;
+        Node* new_node = &tree->node_array[num_leaves + i];
+        new_node->parent = (parser->parent[node] == -1)
+                               ? -1
+                               : parser->rank[parser->parent[node]];
+        for (int k = 0; k < 2; k++) {
+            long child = parser->children[2 * (node - num_leaves) + k];
+            new_node->children[k] =
+                (child < num_leaves) ? child : parser->rank[child];
+        }
+        long time;
+        if (factor > 0) {
+            // multiply time by factor and round up to next integer
+            double scaled_time = parser->height[node] * factor;
+            time = (long)scaled_time;
+            if (time < scaled_time) {
+                time++;
+            }
+        } else {
+            time = i + 1;
+        }
+        if (prev_time > -1 && time >= prev_time) {
+            // there already is a node with this time -- take the next lower
+            // time that is not taken yet
+            time = prev_time - 1;
+        }
+        if (time <= 0) {
+            printf("The factor for discretising trees needs to be bigger\n");
+            return EXIT_FAILURE;
+        }
+        new_node->time = time;
+        prev_time = time;
+    }
+    return EXIT_SUCCESS;
+}
+
+// read tree from newick string
+Tree* parse_newick(char* newick_str, double factor) {
+    Parser* parser = parser_from_newick(newick_str);
+    if (parser == NULL) {
+        return NULL;
+    }
+    Tree* tree = get_empty_tree(parser->num_leaves);
+    if (read_tree(parser, newick_str, factor, tree) != EXIT_SUCCESS) {
+        free_tree(tree);
+        tree = NULL;
+    }
+    free_parser(parser);
+    return tree;
+}
+
+// Read all trees from nexus file line by line. Leaf labels are taken from the
+// TRANSLATE block or, if there is none, from the first tree
+Tree_Array parse_nexus(char* filename, double factor, char*** taxa) {
+    // all trees are read into one arena that grows as needed
+    Tree_Array tree_array = get_empty_tree_array(0, 0);
+
+    FILE* f = fopen(filename, "r");
+    if (f == NULL) {
+        printf("Error. Can't open file %s.\n", filename);
+        return tree_array;
+    }
+
+    Parser* parser = NULL;
+    long capacity = 0;  // number of trees tree_array has space for
+    char* line = NULL;
+    size_t line_size = 0;
+    // body of TRANSLATE block, collected until we find the closing ';'
+    char* translate = NULL;
+    size_t translate_length = 0;
+    int in_translate = FALSE;
+    int failed = FALSE;
+
+    while (!failed && getline(&line, &line_size, f) != -1) {
+        char* pos = line;
+        while (isspace((unsigned char)*pos)) {
+            pos++;
+        }
+        if (!in_translate && parser == NULL &&
+            strncasecmp(pos, "translate", 9) == 0 &&
+            (pos[9] == '\0' || isspace((unsigned char)pos[9]))) {
+            in_translate = TRUE;
+            pos += 9;
+        }
+        if (in_translate) {
+            size_t length = strlen(pos);
+            translate = realloc(translate, translate_length + length + 1);
+            memcpy(translate + translate_length, pos, length + 1);
+            translate_length += length;
+            if (strchr(pos, ';') != NULL) {
+                in_translate = FALSE;
+                parser = parser_from_translate(translate);
+                failed = (parser == NULL);
+            }
+            continue;
+        }
+        if (strncasecmp(pos, "tree", 4) != 0 ||
+            !isspace((unsigned char)pos[4])) {
+            continue;
+        }
+        char* newick_str = strchr(pos, '=');
+        if (newick_str == NULL) {
+            continue;
+        }
+        newick_str++;
+        if (parser == NULL) {
+            parser = parser_from_newick(newick_str);
+            if (parser == NULL) {
+                failed = TRUE;
+                break;
+            }
+        }
+        if (tree_array.num_trees == capacity) {
+            capacity = (capacity == 0) ? 64 : 2 * capacity;
+            reserve_tree_array(&tree_array, capacity, parser->num_leaves);
+        }
+        Tree* tree = &tree_array.trees[tree_array.num_trees];
+        tree_array.num_trees++;
+        if (read_tree(parser, newick_str, factor, tree) != EXIT_SUCCESS) {
+            printf("Couldn't read tree %ld in file %s.\n",
+                   tree_array.num_trees, filename);
+            failed = TRUE;
+        }
+    }
+    free(line);
+    free(translate);
+    fclose(f);
+
+    if (failed) {
+        free_tree_array(tree_array);
+        tree_array = get_empty_tree_array(0, 0);
+    } else if (taxa != NULL && parser != NULL) {
+        *taxa = malloc(parser->num_leaves * sizeof(char*));
+        for (long i = 0; i < parser->num_leaves; i++) {
+            (*taxa)[i] = strdup(parser->labels[i].taxon);
+        }
+    }
+    if (parser != NULL) {
+        free_parser(parser);
+    }
+    return tree_array;
+}
+
+void free_taxa(char** taxa, long num_taxa) {
+    for (long i = 0; i < num_taxa; i++) {
+        free(taxa[i]);
+    }
+    free(taxa);
+}
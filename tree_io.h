@@ -0,0 +1,25 @@
+#ifndef TREE_IO_H_
+#define TREE_IO_H_
+
+#include "tree.h"
+
+// Reading trees given as newick strings or nexus files (C counterpart of
+// tree_parser/tree_io.py).
+// Leaves are saved in node_array in lexicographic order of their labels in the
+// newick strings (translate tokens, if the nexus file has a TRANSLATE block).
+// factor: factor by which the times of internal nodes are multiplied before
+// they are rounded up to integers (DCT); if factor == 0, trees are read as
+// ranked trees
+
+// Read tree from newick string; returns NULL if the string can't be read
+Tree* parse_newick(char* newick_str, double factor);
+
+// Read all trees from nexus file, reading the file only once.
+// If taxa != NULL, *taxa is set to an array of num_leaves taxon names (taxon of
+// leaf i at position i), which needs to be freed with free_taxa.
+// Returns an empty Tree_Array (num_trees = 0) if the file can't be read
+Tree_Array parse_nexus(char* filename, double factor, char*** taxa);
+
+void free_taxa(char** taxa, long num_taxa);
+
+#endif
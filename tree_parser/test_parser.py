@@ -1,3 +1,6 @@
+import os
+import struct
+
 from tree_io import *
 
 
@@ -31,6 +34,139 @@ def test_read_newick_dct():
         return False
 
 
+def test_parse_newick():
+    tree_str = "(((A:1,B:1):2,(C:2,D:2):1):1,E:4);"
+    tree = parse_newick(tree_str.encode(), 0)
+    if not tree or tree_to_cluster_string(tree.contents) != \
+            "[{1,2}:1,{3,4}:2,{1,2,3,4}:3,{1,2,3,4,5}:4]":
+        print("Newick tree " + tree_str + " read incorrectly by C parser.")
+        return False
+    dct_str = "(((A:1,B:1):1,C:2):5,(D:5,E:5):2);"
+    tree = parse_newick(dct_str.encode(), 1)
+    if not tree or tree_to_cluster_string(tree.contents) != \
+            "[{1,2}:1,{1,2,3}:2,{4,5}:5,{1,2,3,4,5}:7]":
+        print("Newick tree " + dct_str + " read incorrectly by C parser.")
+        return False
+    return True
+
+
+# BEAST-style file: taxa in a TRANSLATE block, comments in tree lines
+BEAST_NEXUS = ("#NEXUS\n\nBegin taxa;\n\tDimensions ntax=5;\n"
+               "\t\tTaxlabels\n\t\t\tA\n\t\t\tB\n\t\t\tC\n\t\t\tD\n"
+               "\t\t\tE\n\t\t\t;\nEnd;\nBegin trees;\n\tTranslate\n"
+               "\t\t1 A,\n\t\t2 B,\n\t\t3 C,\n\t\t4 D,\n\t\t5 E\n\t\t;\n"
+               "tree STATE_0 = [&R] ((1:1.0,2:1.0):2.0,(3:2.0,(4:0.5,5:0.5)"
+               ":1.5):1.0):0.0;\n"
+               "tree STATE_1000 [&lnP=-12.3] = (((1[&rate=1.0]:1.0,3:1.0)"
+               ":1.0,5:2.0):1.0,(2:0.5,4:0.5):2.5);\n"
+               "tree STATE_2000 = (4:3.0,((1:1.0,2:1.0):1.0,(3:0.2,5:0.2)"
+               ":1.8):1.0):0.0;\nEnd;\n")
+
+
+def write_beast_nexus(filename):
+    with open(filename, "w") as f:
+        f.write(BEAST_NEXUS)
+
+
+def test_parse_nexus():
+    filename = "test_parse_nexus.nex"
+    write_beast_nexus(filename)
+    correct = True
+    for factor in [0, 10]:
+        expected = read_nexus(filename, factor)
+        taxa = POINTER(c_char_p)()
+        trees = parse_nexus(filename.encode(), factor, byref(taxa))
+        if trees.num_trees != expected.num_trees:
+            correct = False
+            continue
+        # cluster strings include the times, which same_tree ignores
+        for i in range(trees.num_trees):
+            if tree_to_cluster_string(trees.trees[i]) != \
+                    tree_to_cluster_string(expected.trees[i]):
+                correct = False
+        if [taxa[i] for i in range(5)] != [b"A", b"B", b"C", b"D", b"E"]:
+            correct = False
+        free_taxa(taxa, 5)
+    os.remove(filename)
+    return correct
+
+
+def same_trees(tree_array, tree_file):
+    if tree_file.contents.tree_array.num_trees != tree_array.num_trees:
+        return False
+    for i in range(tree_array.num_trees):
+        tree = tree_file_get(tree_file, i)
+        if not tree or tree_to_cluster_string(tree.contents) != \
+                tree_to_cluster_string(tree_array.trees[i]):
+            return False
+    return True
+
+
+def test_tree_file():
+    nexus_filename = "test_tree_file.nex"
+    filename = "test_tree_file.trees"
+    write_beast_nexus(nexus_filename)
+    correct = True
+    # write trees with and without taxon names, then map the file again
+    taxa = POINTER(c_char_p)()
+    trees = parse_nexus(nexus_filename.encode(), 0, byref(taxa))
+    for names, expected in [(taxa, [b"A", b"B", b"C", b"D", b"E"]),
+                            (None, [b"1", b"2", b"3", b"4", b"5"])]:
+        if write_tree_file(filename.encode(), trees, names) != 0:
+            correct = False
+            continue
+        tree_file = open_tree_file(filename.encode())
+        if not tree_file or not same_trees(trees, tree_file):
+            correct = False
+            continue
+        if [tree_file.contents.taxa[i] for i in range(5)] != expected:
+            correct = False
+        # the mapped nodes are the node slab of the tree array
+        view = tree_array_view(tree_file.contents.tree_array)
+        if view.shape != (trees.num_trees, 9, 4) or \
+                view[1, 8, 3] != trees.trees[1].node_array[8].time:
+            correct = False
+        view.release()
+        for i in [-1, trees.num_trees]:
+            if silent(tree_file_get, tree_file, i):
+                correct = False
+        close_tree_file(tree_file)
+    # writes to a full disk fail
+    if os.path.exists("/dev/full") and \
+            silent(write_tree_file, b"/dev/full", trees, None) == 0:
+        correct = False
+    # files with corrupted headers are rejected: (offset of header field,
+    # value) for num_leaves, num_trees, taxa_offset, nodes_offset
+    write_tree_file(filename.encode(), trees, taxa)
+    with open(filename, "rb") as f:
+        data = f.read()
+    nodes_offset = struct.unpack_from("l", data, 56)[0]
+    for field, value in [(32, 1), (32, 1 << 62), (40, -1), (40, 1 << 60),
+                         (48, 0), (48, nodes_offset + 8), (56, len(data) + 8),
+                         (56, 64)]:
+        corrupted = bytearray(data)
+        struct.pack_into("l", corrupted, field, value)
+        with open(filename, "wb") as f:
+            f.write(corrupted)
+        if silent(open_tree_file, filename.encode()):
+            correct = False
+    free_taxa(taxa, 5)
+    # nexus file converted directly, DCTs
+    expected = read_nexus(nexus_filename, 10)
+    if nexus_to_tree_file(nexus_filename.encode(), filename.encode(),
+                          10) != 0:
+        correct = False
+    else:
+        tree_file = open_tree_file(filename.encode())
+        if not tree_file or not same_trees(expected, tree_file):
+            correct = False
+        else:
+            close_tree_file(tree_file)
+    os.remove(nexus_filename)
+    os.remove(filename)
+    return correct
+
+
 if __name__ == "__main__":
     if test_read_newick():
         print("Test tree read correctly.")
@@ -40,4 +176,19 @@ if __name__ == "__main__":
     if test_read_newick_dct():
         print("Test DCT tree read correctly.")
     else:
-        print("Error reading DCT test tree.")
\ No newline at end of file
+        print("Error reading DCT test tree.")
+
+    if test_parse_newick():
+        print("Test trees read correctly by C parser.")
+    else:
+        print("Error reading test trees with C parser.")
+
+    if test_parse_nexus():
+        print("Test nexus file read correctly by C parser.")
+    else:
+        print("Error reading test nexus file with C parser.")
+
+    if test_tree_file():
+        print("Test trees written to and read from tree file correctly.")
+    else:
+        print("Error writing or reading tree file.")
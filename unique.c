@@ -0,0 +1,140 @@
+/*Deduplication of tree collections by hashing*/
+
+#include "unique.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "rng.h"
+
+// tree_hash with the times of internal nodes mixed in, so that DCTs with the
+// same ranked tree but different times get different hashes
+static uint64_t unique_hash(Tree* tree) {
+    long num_leaves = tree->num_leaves;
+    uint64_t hash = tree_hash(tree);
+    for (long i = num_leaves; i < 2 * num_leaves - 1; i++) {
+        hash += rng_mix(((uint64_t)i * RNG_GAMMA) ^
+                        ~(uint64_t)tree->node_array[i].time);
+    }
+    return hash;
+}
+
+// same_tree, also comparing the times of internal nodes
+static int same_tree_times(Tree* tree1, Tree* tree2) {
+    long num_leaves = tree1->num_leaves;
+    for (long i = num_leaves; i < 2 * num_leaves - 1; i++) {
+        if (tree1->node_array[i].time != tree2->node_array[i].time) {
+            return FALSE;
+        }
+    }
+    return same_tree(tree1, tree2);
+}
+
+// representative[i]: first tree in tree_array that is the same as tree i.
+// Every thread has its own hash table (open addressing, linear probing) for
+// the trees whose hash falls into its part, and goes through these trees in
+// input order, so that the first occurrence of a tree is always found first
+static void find_representatives(Tree_Array* tree_array,
+                                 uint64_t* hashes,
+                                 long* representative) {
+    long num_trees = tree_array->num_trees;
+#pragma omp parallel
+    {
+        long num_parts = 1;
+        long part = 0;
+#ifdef _OPENMP
+        num_parts = omp_get_num_threads();
+        part = omp_get_thread_num();
+#endif
+        // the high bits of a hash select the part, the low bits the slot
+        long part_size = 0;
+        for (long i = 0; i < num_trees; i++) {
+            if ((long)((hashes[i] >> 32) % num_parts) == part) {
+                part_size++;
+            }
+        }
+        // at most half of the slots are used
+        uint64_t capacity = 2;
+        while (capacity < 2 * (uint64_t)part_size) {
+            capacity *= 2;
+        }
+        long* slots = malloc(capacity * sizeof(long));
+        for (uint64_t slot = 0; slot < capacity; slot++) {
+            slots[slot] = -1;
+        }
+        for (long i = 0; i < num_trees; i++) {
+            if ((long)((hashes[i] >> 32) % num_parts) != part) {
+                continue;
+            }
+            uint64_t slot = hashes[i] & (capacity - 1);
+            while (slots[slot] != -1) {
+                long j = slots[slot];
+                if (hashes[j] == hashes[i] &&
+                    same_tree_times(&tree_array->trees[j],
+                                    &tree_array->trees[i])) {
+                    break;
+                }
+                slot = (slot + 1) & (capacity - 1);
+            }
+            if (slots[slot] == -1) {
+                slots[slot] = i;
+            }
+            representative[i] = slots[slot];
+        }
+        free(slots);
+    }
+}
+
+Unique_Trees unique_trees(Tree_Array* tree_array) {
+    long num_trees = tree_array->num_trees;
+    long num_leaves = (num_trees > 0) ? tree_array->trees[0].num_leaves : 3;
+    Unique_Trees unique;
+    unique.classes = malloc((num_trees + 1) * sizeof(long));
+    for (long i = 0; i < num_trees; i++) {
+        if (tree_array->trees[i].num_leaves != num_leaves) {
+            printf("Error. The input trees have different numbers of "
+                   "leaves.\n");
+            unique.tree_array = get_empty_tree_array(0, num_leaves);
+            unique.counts = malloc(sizeof(long));
+            return unique;
+        }
+    }
+
+    uint64_t* hashes = malloc((num_trees + 1) * sizeof(uint64_t));
+#pragma omp parallel for schedule(static)
+    for (long i = 0; i < num_trees; i++) {
+        hashes[i] = unique_hash(&tree_array->trees[i]);
+    }
+    long* representative = malloc((num_trees + 1) * sizeof(long));
+    find_representatives(tree_array, hashes, representative);
+    free(hashes);
+
+    // number distinct trees in order of first occurrence
+    long num_unique = 0;
+    for (long i = 0; i < num_trees; i++) {
+        if (representative[i] == i) {
+            unique.classes[i] = num_unique;
+            num_unique++;
+        } else {
+            unique.classes[i] = unique.classes[representative[i]];
+        }
+    }
+    unique.tree_array = get_empty_tree_array(num_unique, num_leaves);
+    unique.counts = calloc(num_unique + 1, sizeof(long));
+    for (long i = 0; i < num_trees; i++) {
+        if (representative[i] == i) {
+            copy_tree(&unique.tree_array.trees[unique.classes[i]],
+                      &tree_array->trees[i]);
+        }
+        unique.counts[unique.classes[i]]++;
+    }
+    free(representative);
+    return unique;
+}
+
+void free_unique_trees(Unique_Trees unique) {
+    free_tree_array(unique.tree_array);
+    free(unique.counts);
+    free(unique.classes);
+}
@@ -0,0 +1,25 @@
+#ifndef UNIQUE_H_
+#define UNIQUE_H_
+
+#include "tree.h"
+
+// Distinct trees of a Tree_Array: tree_array contains a copy of every distinct
+// tree (same_tree and same times of internal nodes, so DCTs are only the same
+// if they have the same times) in order of first occurrence, counts[i] is the number of
+// occurrences of tree_array.trees[i], and classes[j] is the index in
+// tree_array of tree j of the input
+typedef struct Unique_Trees {
+    Tree_Array tree_array;
+    long* counts;
+    long* classes;  // length: number of input trees
+} Unique_Trees;
+
+// distinct trees in tree_array with their multiplicities, found by hashing
+// (tree_hash, with times of internal nodes mixed in) all trees. Hashing and the hash tables are split between
+// threads (OMP_NUM_THREADS); the result does not depend on the number of
+// threads. All trees need the same number of leaves (otherwise the result has
+// no trees)
+Unique_Trees unique_trees(Tree_Array* tree_array);
+void free_unique_trees(Unique_Trees unique);
+
+#endif
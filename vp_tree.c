@@ -0,0 +1,332 @@
+/*Vantage point trees for nearest neighbour queries in RNNI space*/
+
+#include "vp_tree.h"
+
+// subsets with at least this many trees get their distances to the vantage
+// point computed by all threads
+#define VP_PARALLEL_SIZE 256
+
+// distance of a tree (index in tree_array) to a vantage point
+typedef struct Vp_Distance {
+    long distance;
+    long tree;
+} Vp_Distance;
+
+// order by distance, then by tree
+static int compare_vp_distances(const void* a, const void* b) {
+    const Vp_Distance* x = a;
+    const Vp_Distance* y = b;
+    if (x->distance != y->distance) {
+        return (x->distance < y->distance) ? -1 : 1;
+    }
+    return (x->tree > y->tree) - (x->tree < y->tree);
+}
+
+// distances of the trees order[start], ..., order[end - 1] to reference
+static void vantage_distances(Vp_Tree* vp_tree,
+                              long start,
+                              long end,
+                              Reference_Tree* reference,
+                              Findpath_Workspace* workspace,
+                              Vp_Distance* distances) {
+    Tree* trees = vp_tree->tree_array->trees;
+    long* order = vp_tree->order;
+    if (end - start < VP_PARALLEL_SIZE) {
+        for (long i = start; i < end; i++) {
+            distances[i - start].tree = order[i];
+            distances[i - start].distance = reference_distance_workspace(
+                &trees[order[i]], reference, workspace);
+        }
+        return;
+    }
+#pragma omp parallel
+    {
+        Findpath_Workspace* thread_workspace =
+            new_findpath_workspace(reference->num_leaves);
+#pragma omp for schedule(dynamic, DISTANCE_TILE_SIZE)
+        for (long i = start; i < end; i++) {
+            distances[i - start].tree = order[i];
+            distances[i - start].distance = reference_distance_workspace(
+                &trees[order[i]], reference, thread_workspace);
+        }
+        free_findpath_workspace(thread_workspace);
+    }
+}
+
+// build subtree of vp_tree on the trees order[start], ..., order[end - 1] and
+// return index of its root node
+static long build_vp_node(Vp_Tree* vp_tree,
+                          long start,
+                          long end,
+                          Rng* rng,
+                          Findpath_Workspace* workspace,
+                          Vp_Distance* distances) {
+    long* order = vp_tree->order;
+    long node_index = vp_tree->num_nodes++;
+    Vp_Node* node = &vp_tree->nodes[node_index];
+    node->vantage = -1;
+    node->children[0] = -1;
+    node->children[1] = -1;
+    node->start = start;
+    node->end = end;
+    if (end - start <= VP_BUCKET_SIZE) {
+        return node_index;
+    }
+
+    // random vantage point, moved to position start
+    long position = start + rng_below(rng, end - start);
+    long vantage = order[position];
+    order[position] = order[start];
+    order[start] = vantage;
+    Reference_Tree* reference =
+        new_reference_tree(&vp_tree->tree_array->trees[vantage]);
+    vantage_distances(vp_tree, start + 1, end, reference, workspace,
+                      distances);
+    free_reference_tree(reference);
+    long num_distances = end - start - 1;
+    qsort(distances, num_distances, sizeof(Vp_Distance), compare_vp_distances);
+    long min_distance = distances[0].distance;
+    long max_distance = distances[num_distances - 1].distance;
+    if (min_distance == max_distance) {
+        // all trees have the same distance to the vantage point, so they can't
+        // be split -- keep them in one bucket
+        return node_index;
+    }
+    // children[0]: trees with distance at most the median. If that is the
+    // maximum, children[0] gets the trees with smaller distance
+    long median = distances[(num_distances - 1) / 2].distance;
+    if (median == max_distance) {
+        median--;
+    }
+    long split = 0;
+    while (distances[split].distance <= median) {
+        split++;
+    }
+    for (long i = 0; i < num_distances; i++) {
+        order[start + 1 + i] = distances[i].tree;
+    }
+    node->vantage = vantage;
+    node->min_distance[0] = min_distance;
+    node->max_distance[0] = distances[split - 1].distance;
+    node->min_distance[1] = distances[split].distance;
+    node->max_distance[1] = max_distance;
+
+    // distances is reused by the children
+    long inner = build_vp_node(vp_tree, start + 1, start + 1 + split, rng,
+                               workspace, distances);
+    long outer = build_vp_node(vp_tree, start + 1 + split, end, rng, workspace,
+                               distances);
+    node->children[0] = inner;
+    node->children[1] = outer;
+    return node_index;
+}
+
+Vp_Tree* new_vp_tree(Tree_Array* tree_array, uint64_t seed) {
+    long num_trees = tree_array->num_trees;
+    for (long i = 1; i < num_trees; i++) {
+        if (tree_array->trees[i].num_leaves !=
+            tree_array->trees[0].num_leaves) {
+            printf("Error. The input trees have different numbers of "
+                   "leaves.\n");
+            return NULL;
+        }
+    }
+    Vp_Tree* vp_tree = malloc(sizeof(Vp_Tree));
+    vp_tree->tree_array = tree_array;
+    // every node has a vantage point or is a non-empty bucket
+    vp_tree->nodes = malloc((num_trees + 1) * sizeof(Vp_Node));
+    vp_tree->num_nodes = 0;
+    vp_tree->order = malloc((num_trees + 1) * sizeof(long));
+    for (long i = 0; i < num_trees; i++) {
+        vp_tree->order[i] = i;
+    }
+    if (num_trees == 0) {
+        return vp_tree;
+    }
+    Rng rng = rng_stream(seed, 0);
+    Findpath_Workspace* workspace =
+        new_findpath_workspace(tree_array->trees[0].num_leaves);
+    Vp_Distance* distances = malloc(num_trees * sizeof(Vp_Distance));
+    build_vp_node(vp_tree, 0, num_trees, &rng, workspace, distances);
+    free(distances);
+    free_findpath_workspace(workspace);
+    return vp_tree;
+}
+
+void free_vp_tree(Vp_Tree* vp_tree) {
+    free(vp_tree->nodes);
+    free(vp_tree->order);
+    free(vp_tree);
+}
+
+// state of a query
+typedef struct Vp_Query {
+    Vp_Tree* vp_tree;
+    Reference_Tree* reference;  // query tree
+    Mrca_Index* index;          // of query tree, for lower bounds
+    long* mrcas;
+    Findpath_Workspace* workspace;
+    long k;       // number of nearest neighbours, 0 for radius query
+    long radius;  // trees further away than radius are not needed
+    Neighbours result;
+    long capacity;  // of result.trees and result.distances
+} Vp_Query;
+
+// RNNI distance of tree to the query tree if it is at most bound, bound + 1
+// otherwise. The lower bound is checked first, as it is much cheaper
+static long query_distance(Vp_Query* query, long tree, long bound) {
+    Tree* candidate = &query->vp_tree->tree_array->trees[tree];
+    if (rnni_lower_bound(query->index, candidate, query->mrcas) > bound) {
+        return bound + 1;
+    }
+    query->result.num_distances++;
+    return reference_distance_bounded(candidate, query->reference, bound,
+                                      query->workspace);
+}
+
+// add tree with distance to result. Nearest neighbour queries keep result
+// sorted and shrink radius to the distance of the k-th neighbour
+static void add_neighbour(Vp_Query* query, long tree, long distance) {
+    Neighbours* result = &query->result;
+    if (query->k == 0) {
+        if (result->num_neighbours == query->capacity) {
+            query->capacity *= 2;
+            result->trees =
+                realloc(result->trees, query->capacity * sizeof(long));
+            result->distances =
+                realloc(result->distances, query->capacity * sizeof(long));
+        }
+        result->trees[result->num_neighbours] = tree;
+        result->distances[result->num_neighbours] = distance;
+        result->num_neighbours++;
+        return;
+    }
+    // insertion into sorted list of at most k neighbours
+    long i = result->num_neighbours;
+    if (i == query->k) {
+        i--;
+        if (distance > result->distances[i] ||
+            (distance == result->distances[i] && tree > result->trees[i])) {
+            return;
+        }
+    } else {
+        result->num_neighbours++;
+    }
+    while (i > 0 && (result->distances[i - 1] > distance ||
+                     (result->distances[i - 1] == distance &&
+                      result->trees[i - 1] > tree))) {
+        result->trees[i] = result->trees[i - 1];
+        result->distances[i] = result->distances[i - 1];
+        i--;
+    }
+    result->trees[i] = tree;
+    result->distances[i] = distance;
+    if (result->num_neighbours == query->k) {
+        query->radius = result->distances[query->k - 1];
+    }
+}
+
+static void search_vp_node(Vp_Query* query, long node_index) {
+    Vp_Node* node = &query->vp_tree->nodes[node_index];
+    if (node->vantage == -1) {
+        for (long i = node->start; i < node->end; i++) {
+            long tree = query->vp_tree->order[i];
+            long distance = query_distance(query, tree, query->radius);
+            if (distance <= query->radius) {
+                add_neighbour(query, tree, distance);
+            }
+        }
+        return;
+    }
+    // if the vantage point is further than radius + max_distance away, no tree
+    // in this subtree is close enough (triangle inequality)
+    long reach = node->max_distance[1];
+    long bound = (query->radius > LONG_MAX - reach) ? LONG_MAX
+                                                     : query->radius + reach;
+    long distance = query_distance(query, node->vantage, bound);
+    if (distance > bound) {
+        return;
+    }
+    if (distance <= query->radius) {
+        add_neighbour(query, node->vantage, distance);
+    }
+    // child that is more likely to contain close trees first
+    int first = (distance <= node->max_distance[0]) ? 0 : 1;
+    for (int j = 0; j < 2; j++) {
+        int k = (j == 0) ? first : 1 - first;
+        long lower_bound = distance - node->max_distance[k];
+        if (node->min_distance[k] - distance > lower_bound) {
+            lower_bound = node->min_distance[k] - distance;
+        }
+        // radius may have changed while searching the first child
+        if (lower_bound <= query->radius) {
+            search_vp_node(query, node->children[k]);
+        }
+    }
+}
+
+static Neighbours search_vp_tree(Vp_Tree* vp_tree,
+                                 Tree* tree,
+                                 long k,
+                                 long radius) {
+    Vp_Query query;
+    query.vp_tree = vp_tree;
+    query.k = k;
+    query.radius = radius;
+    query.capacity = (k > 0) ? k : 16;
+    query.result.trees = malloc(query.capacity * sizeof(long));
+    query.result.distances = malloc(query.capacity * sizeof(long));
+    query.result.num_neighbours = 0;
+    query.result.num_distances = 0;
+    Tree_Array* tree_array = vp_tree->tree_array;
+    if (vp_tree->num_nodes == 0 || radius < 0) {
+        return query.result;
+    }
+    if (tree->num_leaves != tree_array->trees[0].num_leaves) {
+        printf("Error. The input trees have different numbers of leaves.\n");
+        return query.result;
+    }
+    query.reference = new_reference_tree(tree);
+    query.index = new_mrca_index(tree);
+    query.mrcas = malloc((2 * tree->num_leaves - 1) * sizeof(long));
+    query.workspace = new_findpath_workspace(tree->num_leaves);
+    search_vp_node(&query, 0);
+    free_findpath_workspace(query.workspace);
+    free(query.mrcas);
+    free_mrca_index(query.index);
+    free_reference_tree(query.reference);
+
+    if (k == 0) {
+        // radius query: sort (distance, tree) pairs
+        long n = query.result.num_neighbours;
+        Vp_Distance* sorted = malloc((n + 1) * sizeof(Vp_Distance));
+        for (long i = 0; i < n; i++) {
+            sorted[i].distance = query.result.distances[i];
+            sorted[i].tree = query.result.trees[i];
+        }
+        qsort(sorted, n, sizeof(Vp_Distance), compare_vp_distances);
+        for (long i = 0; i < n; i++) {
+            query.result.distances[i] = sorted[i].distance;
+            query.result.trees[i] = sorted[i].tree;
+        }
+        free(sorted);
+    }
+    return query.result;
+}
+
+Neighbours vp_tree_nearest(Vp_Tree* vp_tree, Tree* tree, long k) {
+    if (k <= 0) {
+        // no neighbours needed (negative radius)
+        return search_vp_tree(vp_tree, tree, 0, -1);
+    }
+    return search_vp_tree(vp_tree, tree, k, LONG_MAX);
+}
+
+Neighbours vp_tree_within(Vp_Tree* vp_tree, Tree* tree, long radius) {
+    return search_vp_tree(vp_tree, tree, 0, radius);
+}
+
+void free_neighbours(Neighbours neighbours) {
+    free(neighbours.trees);
+    free(neighbours.distances);
+}
@@ -0,0 +1,61 @@
+#ifndef VP_TREE_H_
+#define VP_TREE_H_
+
+#include "exploring_rnni.h"
+
+// subsets of at most this many trees are not split any further, but scanned
+#define VP_BUCKET_SIZE 8
+
+// Node of a vantage point tree: all trees in the subtree of the node except
+// the vantage point itself are split into children[0] (RNNI distance to the
+// vantage point at most the median distance) and children[1] (bigger
+// distances). min_distance[k] and max_distance[k] are the smallest and biggest
+// distance of a tree in children[k] to the vantage point, so that by the
+// triangle inequality a tree at distance d from the vantage point has at least
+// distance max(d - max_distance[k], min_distance[k] - d) to all trees in
+// children[k].
+// Buckets (vantage == -1) are leaves of the vp tree containing the trees
+// order[start], ..., order[end - 1]
+typedef struct Vp_Node {
+    long vantage;      // index of vantage point in tree_array, -1 for buckets
+    long children[2];  // indices of child nodes in nodes
+    long min_distance[2];
+    long max_distance[2];
+    long start;
+    long end;
+} Vp_Node;
+
+// Vantage point tree: metric index over tree_array for nearest neighbour and
+// radius queries. The index only refers to the trees of tree_array, which must
+// not change while the index is used
+typedef struct Vp_Tree {
+    Tree_Array* tree_array;
+    Vp_Node* nodes;  // nodes[0] is the root
+    long num_nodes;
+    long* order;  // indices of trees in buckets
+} Vp_Tree;
+
+// Result of a query: num_neighbours trees (indices in tree_array) sorted by
+// their distance to the query tree (ties by index). num_distances is the
+// number of RNNI distances the query needed to compute
+typedef struct Neighbours {
+    long* trees;
+    long* distances;
+    long num_neighbours;
+    long num_distances;
+} Neighbours;
+
+// build vp tree over tree_array with O(num_trees log num_trees) distance
+// computations, choosing vantage points with random numbers from
+// rng_stream(seed, 0). Distances to vantage points are computed in parallel
+// (OMP_NUM_THREADS)
+Vp_Tree* new_vp_tree(Tree_Array* tree_array, uint64_t seed);
+void free_vp_tree(Vp_Tree* vp_tree);
+
+// k trees of the index closest to tree
+Neighbours vp_tree_nearest(Vp_Tree* vp_tree, Tree* tree, long k);
+// all trees of the index with distance at most radius to tree
+Neighbours vp_tree_within(Vp_Tree* vp_tree, Tree* tree, long radius);
+void free_neighbours(Neighbours neighbours);
+
+#endif